@@ -24,31 +24,150 @@
 #define _CRT_SECURE_NO_WARNINGS // for <fmt/time.h> (providing fmt::localtime)
 #endif
 
+#include "pmb.h"
+
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
+#include <cctype>
+#include <cerrno>
 #include <chrono>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <execution>
 #include <filesystem>
+#include <fstream>
 #include <functional>
+#include <future>
 #include <iterator>
 #include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <numeric>
+#include <optional>
+#include <queue>
 #include <random>
+#include <sstream>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <tuple>
 #include <utility>
 #include <variant>
+#include <vector>
+#include <boost/iterator/counting_iterator.hpp>
 #include <boost/program_options.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
 #include <fmt/format.h>
 #include <fmt/ostream.h> // to print boost::format_options::options_description
 #include <fmt/time.h>
 #include <gsl/gsl>
 
+// Standard library implementations whose parallel algorithms use TBB can have
+// their concurrency limited, for scaling sweeps (see --threads).
+#if defined(_PSTL_PAR_BACKEND_TBB) && __has_include(<tbb/global_control.h>)
+#define PMB_HAVE_TBB_CONTROL
+#include <tbb/global_control.h>
+#include <tbb/task_arena.h>
+#include <tbb/task_scheduler_observer.h>
+#endif
+
+// POSIX lets allocations be mapped directly, and optionally use huge pages.
+#if __has_include(<sys/mman.h>) && __has_include(<unistd.h>)
+#define PMB_HAVE_MMAP
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// POSIX lets a file be mapped as the array (see --input and --output).
+#if defined(PMB_HAVE_MMAP) && __has_include(<fcntl.h>) \
+        && __has_include(<sys/stat.h>)
+#define PMB_HAVE_MMAP_FILES
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+// Linux system calls place memory on, and run threads on, NUMA nodes.
+#if defined(__linux__) && __has_include(<sys/syscall.h>)
+#define PMB_HAVE_NUMA
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Linux counts hardware events, such as cache misses, for a process.
+#if defined(__linux__) && __has_include(<linux/perf_event.h>) \
+        && __has_include(<sys/syscall.h>)
+#define PMB_HAVE_PERF
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Linux reports, and can reset, a process's peak resident set size.
+#if defined(__linux__)
+#define PMB_HAVE_PROCFS
+#endif
+
+// POSIX reports how many page faults and context switches a process has taken.
+#if __has_include(<sys/resource.h>)
+#define PMB_HAVE_RUSAGE
+#include <sys/resource.h>
+#endif
+
+#if __has_include(<sys/utsname.h>) && __has_include(<unistd.h>)
+#define PMB_HAVE_UNAME
+#include <sys/utsname.h>
+#include <unistd.h>
+#endif
+
+// Keeps a function from being inlined. The replacement operator new and delete
+// use this, since GCC otherwise sees through them and warns of a mismatch.
+#if defined(__GNUC__)
+#define NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define NOINLINE __declspec(noinline)
+#else
+#define NOINLINE
+#endif
+
+// Compiles a function for several instruction sets, calling the best one the
+// CPU supports (chosen once, at startup). This needs ifunc support, so only
+// x86-64 Linux gets it; elsewhere the one version is built for the baseline
+// (which on AArch64 includes NEON).
+#if defined(__has_attribute) && defined(__x86_64__) && defined(__linux__)
+#if __has_attribute(target_clones)
+#define MULTIVERSION \
+        __attribute__((target_clones("avx512f", "avx2", "default")))
+#endif
+#endif
+
+#ifndef MULTIVERSION
+#define MULTIVERSION
+#endif
+
+// Which sorting kernels to build: comma-separated names of element types,
+// algorithms, and policies, as the options take them, or "all". A kernel is
+// built if its type, algorithm, and policy are all listed (see CMakeLists.txt).
+#ifndef PMB_SORT_KERNEL_TYPES
+#define PMB_SORT_KERNEL_TYPES "all"
+#endif
+#ifndef PMB_SORT_KERNEL_ALGORITHMS
+#define PMB_SORT_KERNEL_ALGORITHMS "all"
+#endif
+#ifndef PMB_SORT_KERNEL_POLICIES
+#define PMB_SORT_KERNEL_POLICIES "all"
+#endif
+
 // Use this to mark places a compiler might wrongly think are possible to reach.
 #if defined(_MSC_VER)
 #define NOT_REACHED() __assume(false)
@@ -62,6 +181,7 @@ namespace {
     using namespace std::chrono_literals;
     using namespace std::execution;
     namespace po = boost::program_options;
+    namespace pt = boost::property_tree;
 
     // See "overloaded" in http://stroustrup.com/tour2.html, p. 176.
     template<typename... Fs>
@@ -78,399 +198,9079 @@ namespace {
 
     std::string program_name;
 
+    // Where human-readable progress and results go. This is stdout unless the
+    // machine-readable results are going there instead.
+    std::FILE* default_console = stdout;
+
+    // Where this thread's progress goes. A thread starts with the default,
+    // so concurrent instances (see --instances) can log elsewhere.
+    thread_local std::FILE* console = default_console;
+
+    // Elements per separately seeded block, when generating in blocks.
+    constexpr std::size_t generation_block_length {std::size_t{1} << 16};
+
+    // Called before exiting with an error, if set, to stop a thread that
+    // would otherwise outlive the globals it uses (see Sampler).
+    void (*before_exit)() = nullptr;
+
     [[noreturn]]
     void die(const std::string_view message)
     {
+        if (const auto stop = std::exchange(before_exit, nullptr)) stop();
         fmt::print(stderr, "{}: error: {}\n", program_name, message);
         std::exit(EXIT_FAILURE);
     }
 
+    // The in-tree execution policy, whose algorithms run on the pool.
+    struct pool_policy { };
+    constexpr pool_policy pmb_par {};
+
     using ParallelMode = std::variant<sequenced_policy,
                                       parallel_policy,
-                                      parallel_unsequenced_policy>;
-}
+                                      parallel_unsequenced_policy,
+                                      pool_policy>;
+
+    // The name of the option that selects an execution policy.
+    template<typename Policy>
+    constexpr std::string_view policy_name {};
 
-// ParallelMode http://fmtlib.net/dev/api.html#formatting-user-defined-types
-namespace fmt {
     template<>
-    struct formatter<ParallelMode> {
-        template<typename ParseContext>
-        constexpr auto parse(ParseContext& ctx) { return std::begin(ctx); }
+    constexpr std::string_view policy_name<sequenced_policy> {"seq"};
 
-        template<typename FormatContext>
-        auto format(const ParallelMode& mode, FormatContext& ctx)
-        {
-            const auto summary = visit(MultiLambda{
-                [](sequenced_policy) noexcept {
-                    return "std::execution::seq (do not parallelize)";
-                },
-                [](parallel_policy) noexcept {
-                    return "std::execution::par (parallelize)";
-                },
-                [](parallel_unsequenced_policy) noexcept {
-                    return "std::execution::par_unseq"
-                           " (parallelize/vectorize/migrate)";
-                }
-            }, mode);
+    template<>
+    constexpr std::string_view policy_name<parallel_policy> {"par"};
 
-            return format_to(std::begin(ctx), "{}", summary);
-        }
+    template<>
+    constexpr std::string_view policy_name<parallel_unsequenced_policy> {
+        "par-unseq"
     };
-}
 
-namespace {
-    // Formattable names of specific configuration parameters (see Parameters).
-    struct ParameterLabel {
-        static constexpr auto width = 9;
+    template<>
+    constexpr std::string_view policy_name<pool_policy> {"pmb-par"};
 
-        std::string_view name;
+    // Gets the name of the option that selects a dynamic execution policy.
+    [[nodiscard]]
+    std::string_view option_name(const ParallelMode& mode) noexcept
+    {
+        return visit([](auto policy) noexcept {
+            return policy_name<decltype(policy)>;
+        }, mode);
+    }
+
+    // A record sorted by its key, carrying a payload of the same width.
+    template<typename Key>
+    struct KeyValue {
+        Key key;
+        Key value;
+
+        [[nodiscard]]
+        friend constexpr bool operator<(const KeyValue& lhs,
+                                        const KeyValue& rhs) noexcept
+        {
+            return lhs.key < rhs.key;
+        }
     };
 
+    // Information about how to generate and hash each type of element. The
+    // elements' hash is the wrapping sum of their hash words, so it does not
+    // depend on the elements' order. Each specialization has:
+    //
+    //  - name, which is the argument to --type that selects it
+    //  - description, which is shown in the parameters
+    //  - Engine, the PRNG whose output each element is made from
+    //  - Hash, the unsigned integer type of hash words and hashes
+    //  - make(gen), which makes a single pseudorandom element
+    //  - from_unit(u, gen), which makes an element whose order is that of u,
+    //    a value in [0, 1), using gen only for anything not ordered (payloads)
+    //  - hash(x), which gets an element's hash word
+    //  - radix_key(x), an unsigned integer that orders elements as < does
+    template<typename T>
+    struct ElementTraits;
+
+    // Maps IEEE 754 bits to an unsigned integer with the same order as the
+    // floating-point value (for non-NaN values, with -0 just below +0).
+    template<typename Bits>
     [[nodiscard]]
-    constexpr ParameterLabel
-    operator""_pl(const char* const s, const std::size_t count)
+    constexpr Bits ordered_float_bits(const Bits bits) noexcept
     {
-        return {{s, count}};
+        constexpr auto sign = Bits{1} << (sizeof(Bits) * CHAR_BIT - 1u);
+        return static_cast<Bits>((bits & sign) ? ~bits : bits | sign);
     }
-}
 
-// ParameterLabel http://fmtlib.net/dev/api.html#formatting-user-defined-types
-namespace fmt {
     template<>
-    struct formatter<ParameterLabel> {
-        template<typename ParseContext>
-        constexpr auto parse(ParseContext& ctx) { return std::begin(ctx); }
+    struct ElementTraits<std::uint32_t> {
+        static constexpr std::string_view name {"u32"};
+        static constexpr std::string_view description {"unsigned integer"};
 
-        template<typename FormatContext>
-        auto format(const ParameterLabel label, FormatContext& ctx)
+        using Engine = std::mt19937;
+        using Hash = std::uint32_t;
+
+        static_assert(same_range_v<Engine, std::numeric_limits<std::uint32_t>>,
+                      "the PRNG and the output type have different ranges");
+
+        [[nodiscard]]
+        static std::uint32_t make(Engine& gen)
         {
-            return format_to(std::begin(ctx), "{:>{}}:  ", // right-justified
-                             label.name, ParameterLabel::width);
+            return static_cast<std::uint32_t>(gen());
         }
-    };
-}
 
-namespace {
-    // Configuration parameters that control a run.
-    struct Parameters {
-        static constexpr auto label_width = 9;
+        [[nodiscard]]
+        static std::uint32_t from_unit(const double u, Engine&) noexcept
+        {
+            return static_cast<std::uint32_t>(u * 0x1p32);
+        }
 
-        std::size_t length;
-        unsigned seed;
-        std::string_view seed_origin;
-        ParallelMode mode;
-        int inplace_reps;
-        bool show_start_time;
+        [[nodiscard]]
+        static constexpr Hash hash(const std::uint32_t x) noexcept { return x; }
+
+        [[nodiscard]]
+        static constexpr std::uint32_t radix_key(const std::uint32_t x) noexcept
+        {
+            return x;
+        }
     };
 
-    // Helper for fmt::formatter<Parameters>::format. Prints timestamp.
-    template<typename OutputIt>
-    [[nodiscard]]
-    OutputIt format_localnow_to(const OutputIt out)
-    {
-        // Obtain the current time.
-        using clock = std::chrono::system_clock;
-        const auto time = fmt::localtime(clock::to_time_t(clock::now()));
+    template<>
+    struct ElementTraits<std::uint64_t> {
+        static constexpr std::string_view name {"u64"};
+        static constexpr std::string_view description {"unsigned integer"};
 
-        // Convert it to a string, then use that string (see below for why).
-        const auto repr = fmt::format("{:%T%z}", time);
-        return fmt::format_to(out, "Current time is {}.\n", repr);
+        using Engine = std::mt19937_64;
+        using Hash = std::uint64_t;
 
-        // The code shown below crashes or behaves erratically. It appears to
-        // (try to) write past the end of a buffer. Perhaps someone will point
-        // out my mistake or a bug in fmtlib. For now, I am working around it
-        // with the ugly hack that appears above.
-        //
-        // return fmt::format_to(out, "Current time is {:%T%z}.\n", time);
-    }
+        static_assert(same_range_v<Engine, std::numeric_limits<std::uint64_t>>,
+                      "the PRNG and the output type have different ranges");
 
-    // Helper for fmt::formatter<Parameters>::format. Prints array length.
-    template<typename OutputIt>
-    [[nodiscard]]
-    OutputIt format_length_to(const OutputIt out, const std::size_t length)
-    {
-        static constexpr std::size_t kilo {1024u}, mega {kilo * kilo};
+        [[nodiscard]]
+        static std::uint64_t make(Engine& gen)
+        {
+            return static_cast<std::uint64_t>(gen());
+        }
 
-        const auto bytes = length * sizeof(unsigned);
+        [[nodiscard]]
+        static std::uint64_t from_unit(const double u, Engine&) noexcept
+        {
+            return static_cast<std::uint64_t>(u * 0x1p64);
+        }
 
-        return fmt::format_to(out, "{}{} element{} ({}{} MiB)\n",
-                              "length"_pl, length, (length == 1u ? "" : "s"),
-                              (bytes % mega == 0u ? "" : "~"), bytes / mega);
-    }
-}
+        [[nodiscard]]
+        static constexpr Hash hash(const std::uint64_t x) noexcept { return x; }
+
+        [[nodiscard]]
+        static constexpr std::uint64_t radix_key(const std::uint64_t x) noexcept
+        {
+            return x;
+        }
+    };
 
-// Parameters http://fmtlib.net/dev/api.html#formatting-user-defined-types
-namespace fmt {
     template<>
-    struct formatter<Parameters> {
-        template<typename ParseContext>
-        constexpr auto parse(ParseContext& ctx) { return std::cbegin(ctx); }
+    struct ElementTraits<float> {
+        static constexpr std::string_view name {"f32"};
+        static constexpr std::string_view description {"float in [0, 1)"};
 
-        template<typename FormatContext>
-        auto format(const Parameters& params, FormatContext& ctx)
+        using Engine = std::mt19937;
+        using Hash = std::uint32_t;
+
+        static_assert(sizeof(float) == sizeof(Hash));
+
+        // Uses the high 24 bits, as many as the significand holds exactly.
+        [[nodiscard]]
+        static float make(Engine& gen)
         {
-            auto out = std::begin(ctx);
+            return static_cast<float>(gen() >> 8u) * 0x1p-24f;
+        }
 
-            // Print human-readable current time (and blank line), if requested.
-            if (params.show_start_time) out = format_localnow_to(out);
+        // Rounds down, since rounding to nearest could give 1.
+        [[nodiscard]]
+        static float from_unit(const double u, Engine&) noexcept
+        {
+            return static_cast<float>(std::floor(u * 0x1p24)) * 0x1p-24f;
+        }
 
-            // Show the specified length and about how much space it will use.
-            out = format_length_to(out, params.length);
+        [[nodiscard]]
+        static Hash hash(const float x) noexcept
+        {
+            Hash bits {};
+            std::memcpy(&bits, &x, sizeof bits);
+            return bits;
+        }
 
-            // Show the seed the PRNG will use, and say where it came from.
-            out = format_to(out, "{}{}  ({})\n", "seed"_pl,
-                            params.seed, params.seed_origin);
+        [[nodiscard]]
+        static std::uint32_t radix_key(const float x) noexcept
+        {
+            return ordered_float_bits(hash(x));
+        }
+    };
 
-            // Name and "explain" the execution policy and if we rerun the sort.
-            out = format_to(out, "{}{}", "sort mode"_pl, params.mode);
-            if (params.inplace_reps > 1)
-                out = format_to(out, "  [repeating {}x]", params.inplace_reps);
-            return format_to(out, "\n");
+    template<>
+    struct ElementTraits<double> {
+        static constexpr std::string_view name {"f64"};
+        static constexpr std::string_view description {"double in [0, 1)"};
+
+        using Engine = std::mt19937_64;
+        using Hash = std::uint64_t;
+
+        static_assert(sizeof(double) == sizeof(Hash));
+
+        // Uses the high 53 bits, as many as the significand holds exactly.
+        [[nodiscard]]
+        static double make(Engine& gen)
+        {
+            return static_cast<double>(gen() >> 11u) * 0x1p-53;
+        }
+
+        [[nodiscard]]
+        static double from_unit(const double u, Engine&) noexcept { return u; }
+
+        [[nodiscard]]
+        static Hash hash(const double x) noexcept
+        {
+            Hash bits {};
+            std::memcpy(&bits, &x, sizeof bits);
+            return bits;
+        }
+
+        [[nodiscard]]
+        static std::uint64_t radix_key(const double x) noexcept
+        {
+            return ordered_float_bits(hash(x));
         }
     };
-}
 
-namespace {
-    [[nodiscard]]
-    std::tuple<po::options_description, po::positional_options_description>
-    describe_options()
-    {
-        po::options_description desc {"Options to configure the benchmark"};
-        desc.add_options()
-                ("help,h", "show this message") // TODO: list --help separately
-                ("length,l", po::value<std::size_t>(),
-                             "specify how many elements to generate and sort")
-                ("seed,s", po::value<unsigned>(),
-                           "custom seed for PRNG (omit to use system entropy)")
-                ("twice,2", "after sorting, sort again (may test adaptivity)")
-                ("time,t", "display human-readable start time")
-                ("seq,S", "don't try to parallelize")
-                ("par,P", "try to parallelize (default)")
-                ("par-unseq,U",
-                        "try to parallelize, may migrate thread and vectorize");
+    // Key-value records are hashed so payloads that move without their keys,
+    // or keys that move without their payloads, usually change the hash.
+    template<typename Key, typename Gen>
+    struct KeyValueTraits {
+        using Engine = Gen;
+        using Hash = Key;
 
-        po::positional_options_description pos_desc;
-        pos_desc.add("length", 1);
+        [[nodiscard]]
+        static KeyValue<Key> make(Engine& gen)
+        {
+            static_assert(same_range_v<Engine, std::numeric_limits<Key>>,
+                          "the PRNG and the key type have different ranges");
 
-        return {desc, pos_desc};
-    }
+            const auto key = static_cast<Key>(gen());
+            return {key, static_cast<Key>(gen())};
+        }
 
-    [[nodiscard]]
-    po::variables_map
-    parse_cmdline_args(const int argc,
-                       const gsl::not_null<const char* const*> argv)
-    {
-        const auto [desc, pos_desc] = describe_options();
+        [[nodiscard]]
+        static KeyValue<Key> from_unit(const double u, Engine& gen)
+        {
+            static_assert(sizeof(Key) == 4u || sizeof(Key) == 8u);
 
-        po::variables_map vm;
-        try {
-            po::store(po::command_line_parser{argc, argv}
-                        .options(desc).positional(pos_desc).run(), vm);
+            // 2 to the number of bits in a key, as a literal, so it's constant.
+            constexpr auto scale = (sizeof(Key) == 4u ? 0x1p32 : 0x1p64);
+            return {static_cast<Key>(u * scale), static_cast<Key>(gen())};
         }
-        catch (const po::error& e) {
-            die(e.what());
+
+        [[nodiscard]]
+        static constexpr Hash hash(const KeyValue<Key>& x) noexcept
+        {
+            constexpr auto odd = static_cast<Key>(0x9E3779B97F4A7C15u);
+            return static_cast<Key>(x.key * odd + x.value);
         }
-        po::notify(vm);
 
-        if (vm.count("help")) {
-            fmt::print("{}", desc);
-            std::exit(EXIT_SUCCESS);
+        [[nodiscard]]
+        static constexpr Key radix_key(const KeyValue<Key>& x) noexcept
+        {
+            return x.key;
         }
+    };
 
-        return vm;
-    }
+    template<>
+    struct ElementTraits<KeyValue<std::uint32_t>>
+            : KeyValueTraits<std::uint32_t, std::mt19937> {
+        static constexpr std::string_view name {"kv64"};
+        static constexpr std::string_view description {
+                "record of unsigned 32-bit key and payload"};
+    };
+
+    template<>
+    struct ElementTraits<KeyValue<std::uint64_t>>
+            : KeyValueTraits<std::uint64_t, std::mt19937_64> {
+        static constexpr std::string_view name {"kv128"};
+        static constexpr std::string_view description {
+                "record of unsigned 64-bit key and payload"};
+    };
+
+    // Stands for an element type, so a variant can hold a choice of one.
+    template<typename T>
+    struct ElementTag {
+        using type = T;
+        static constexpr auto name = ElementTraits<T>::name;
+    };
+
+    using ElementType = std::variant<ElementTag<std::uint32_t>,
+                                     ElementTag<std::uint64_t>,
+                                     ElementTag<float>,
+                                     ElementTag<double>,
+                                     ElementTag<KeyValue<std::uint32_t>>,
+                                     ElementTag<KeyValue<std::uint64_t>>>;
 
     [[nodiscard]]
-    std::size_t extract_length(const po::variables_map& vm)
+    std::size_t element_size(const ElementType& type) noexcept
     {
-        if (!vm.count("length")) die("no length specified");
-
-        const auto length = vm.at("length").as<std::size_t>();
-        if (length >= std::numeric_limits<std::size_t>::max()
-                        / sizeof(unsigned))
-            die("length is representable but too big to meaningfully try");
+        return visit([](auto tag) noexcept {
+            return sizeof(typename decltype(tag)::type);
+        }, type);
+    }
 
-        return length;
+    [[nodiscard]]
+    std::string_view element_name(const ElementType& type) noexcept
+    {
+        return visit([](auto tag) noexcept { return tag.name; }, type);
     }
 
+    template<typename Variant, std::size_t... Ix>
     [[nodiscard]]
-    std::tuple<unsigned, std::string_view>
-    obtain_seed_info(const po::variables_map& vm)
+    std::optional<Variant>
+    find_alternative(const std::string_view name, std::index_sequence<Ix...>)
     {
-        if (vm.count("seed"))
-            return {vm.at("seed").as<unsigned>(), "provided by the user"};
+        std::optional<Variant> ret;
 
-        return {std::random_device{}(), "generated by the system"};
+        ((name == std::variant_alternative_t<Ix, Variant>::name
+            ? void(ret = std::variant_alternative_t<Ix, Variant>{})
+            : void()), ...);
+
+        return ret;
     }
 
+    // Finds the alternative of a variant of tag types that has a given name.
+    template<typename Variant>
     [[nodiscard]]
-    ParallelMode extract_dynamic_execution_policy(const po::variables_map& vm)
+    std::optional<Variant> find_alternative(const std::string_view name)
     {
-        const auto got_seq = vm.count("seq");
+        return find_alternative<Variant>(
+                name, std::make_index_sequence<std::variant_size_v<Variant>>{});
+    }
+
+    // Sorting algorithms (see --algorithm), each of which works in any mode.
+    struct StdSort {
+        static constexpr std::string_view name {"sort"};
+    };
+
+    struct StableSort {
+        static constexpr std::string_view name {"stable"};
+    };
+
+    struct PartialSort {
+        static constexpr std::string_view name {"partial"};
+    };
+
+    struct NthElement {
+        static constexpr std::string_view name {"nth"};
+    };
+
+    struct MergeSort {
+        static constexpr std::string_view name {"merge"};
+    };
+
+    struct RadixSort {
+        static constexpr std::string_view name {"radix"};
+    };
+
+    struct SampleSort {
+        static constexpr std::string_view name {"sample"};
+    };
+
+    using SortAlgorithm = std::variant<StdSort,
+                                       StableSort,
+                                       PartialSort,
+                                       NthElement,
+                                       MergeSort,
+                                       RadixSort,
+                                       SampleSort>;
+
+    // Tells if an algorithm only sorts up to, or partitions at, the middle.
+    [[nodiscard]]
+    bool uses_middle(const SortAlgorithm& algorithm) noexcept
+    {
+        return visit(MultiLambda{
+            [](auto) noexcept { return false; },
+            [](PartialSort) noexcept { return true; },
+            [](NthElement) noexcept { return true; }
+        }, algorithm);
+    }
+
+    [[nodiscard]]
+    std::string_view algorithm_name(const SortAlgorithm& algorithm) noexcept
+    {
+        return visit([](auto tag) noexcept { return tag.name; }, algorithm);
+    }
+
+    // Calls an action with each name in a comma-separated list, without
+    // spaces around it, until it returns false. Returns if it never did.
+    template<typename Action>
+    constexpr bool for_each_listed(const std::string_view list,
+                                   const Action& action) noexcept
+    {
+        for (std::size_t first = 0u; first <= list.size(); ) {
+            const auto last = std::min(list.find(',', first), list.size());
+            auto name = list.substr(first, last - first);
+            name.remove_prefix(std::min(name.find_first_not_of(' '),
+                                        name.size()));
+            name.remove_suffix(name.size() - (name.find_last_not_of(' ') + 1u));
+            if (!action(name)) return false;
+            first = last + 1u;
+        }
+
+        return true;
+    }
+
+    // Checks if a comma-separated list of names, or "all", has a name.
+    [[nodiscard]]
+    constexpr bool lists(const std::string_view list,
+                         const std::string_view name) noexcept
+    {
+        if (list == "all") return true;
+
+        return !for_each_listed(list, [name](const std::string_view listed) {
+            return listed != name;
+        });
+    }
+
+    // Checks if a comma-separated list of names, or "all", has only names
+    // from a given set.
+    template<std::size_t N>
+    [[nodiscard]]
+    constexpr bool lists_only(const std::string_view list,
+                              const std::array<std::string_view, N>& names)
+            noexcept
+    {
+        if (list == "all") return true;
+
+        return for_each_listed(list, [&names](const std::string_view listed) {
+            for (const auto name : names)
+                if (listed == name) return true;
+            return false;
+        });
+    }
+
+    template<typename Variant, std::size_t... Ix>
+    [[nodiscard]]
+    constexpr std::array<std::string_view, sizeof...(Ix)>
+    alternative_names(std::index_sequence<Ix...>) noexcept
+    {
+        return {std::variant_alternative_t<Ix, Variant>::name...};
+    }
+
+    // Gets the names of the alternatives of a variant of tag types.
+    template<typename Variant>
+    [[nodiscard]]
+    constexpr auto alternative_names() noexcept
+    {
+        return alternative_names<Variant>(
+                std::make_index_sequence<std::variant_size_v<Variant>>{});
+    }
+
+    template<std::size_t... Ix>
+    [[nodiscard]]
+    constexpr std::array<std::string_view, sizeof...(Ix)>
+    policy_names(std::index_sequence<Ix...>) noexcept
+    {
+        return {policy_name<std::variant_alternative_t<Ix, ParallelMode>>...};
+    }
+
+    // Gets the names of the options that select execution policies.
+    [[nodiscard]]
+    constexpr auto policy_names() noexcept
+    {
+        return policy_names(
+                std::make_index_sequence<std::variant_size_v<ParallelMode>>{});
+    }
+
+    // A misspelled name in a kernel list would quietly build no kernels for
+    // it, so stop the build instead.
+    static_assert(lists_only(PMB_SORT_KERNEL_TYPES,
+                             alternative_names<ElementType>()),
+                  "PMB_SORT_KERNEL_TYPES has an unknown element type");
+    static_assert(lists_only(PMB_SORT_KERNEL_ALGORITHMS,
+                             alternative_names<SortAlgorithm>()),
+                  "PMB_SORT_KERNEL_ALGORITHMS has an unknown algorithm");
+    static_assert(lists_only(PMB_SORT_KERNEL_POLICIES, policy_names()),
+                  "PMB_SORT_KERNEL_POLICIES has an unknown policy");
+
+    // Checks if this build sorts an element type with any kernel.
+    template<typename T>
+    constexpr bool has_sort_kernels = lists(PMB_SORT_KERNEL_TYPES,
+                                            ElementTraits<T>::name);
+
+    // Checks if this build has the kernel for an algorithm, with a policy, on
+    // an element type. Each kernel that's built is its own instantiation of
+    // sort_kernel(), so nothing is chosen at run time within the sort.
+    template<typename Algorithm, typename Policy, typename T>
+    constexpr bool has_sort_kernel =
+            has_sort_kernels<T>
+            && lists(PMB_SORT_KERNEL_ALGORITHMS, Algorithm::name)
+            && lists(PMB_SORT_KERNEL_POLICIES, policy_name<Policy>);
+
+    template<typename Variant, typename Action, std::size_t... Ix>
+    void for_each_alternative(const Action& action, std::index_sequence<Ix...>)
+    {
+        (action(std::variant_alternative_t<Ix, Variant>{}), ...);
+    }
+
+    // Calls an action with each alternative of a variant, in order.
+    template<typename Variant, typename Action>
+    void for_each_alternative(const Action& action)
+    {
+        for_each_alternative<Variant>(
+                action,
+                std::make_index_sequence<std::variant_size_v<Variant>>{});
+    }
+
+    // Checks if this build has the kernel for a sort, at run time.
+    [[nodiscard]]
+    bool sort_kernel_built(const ElementType& type,
+                           const SortAlgorithm& algorithm,
+                           const ParallelMode& mode) noexcept
+    {
+        return visit([](auto tag, auto kind, auto policy) noexcept {
+            return has_sort_kernel<decltype(kind), decltype(policy),
+                                   typename decltype(tag)::type>;
+        }, type, algorithm, mode);
+    }
+
+    // Prints the sorting kernels this build has (see --list-kernels): a line
+    // for each element type and algorithm, with the policies it's built for.
+    void print_sort_kernels()
+    {
+        auto built = 0, total = 0;
+
+        fmt::print("Sorting kernels (type, algorithm: policies):\n");
+
+        for_each_alternative<ElementType>([&](auto tag) {
+            using T = typename decltype(tag)::type;
+
+            for_each_alternative<SortAlgorithm>([&](auto algorithm) {
+                using Algorithm = decltype(algorithm);
+                std::string policies;
+
+                for_each_alternative<ParallelMode>([&](auto policy) {
+                    using Policy = decltype(policy);
+
+                    ++total;
+                    if constexpr (has_sort_kernel<Algorithm, Policy, T>) {
+                        ++built;
+                        policies += fmt::format(" {}", policy_name<Policy>);
+                    }
+                });
+
+                if (!policies.empty()) {
+                    fmt::print("  {:<6} {:<8}{}\n", ElementTraits<T>::name,
+                               fmt::format("{}:", Algorithm::name), policies);
+                }
+            });
+        });
+
+        fmt::print("{} of {} kernels built.\n", built, total);
+    }
+
+    // STREAM-style bandwidth kernels (see --kernel), over the array a and
+    // two more arrays, b and c, of the same length. Each has the stage label
+    // it is timed under, and how many whole arrays it reads or writes.
+    struct CopyKernel {
+        static constexpr std::string_view name {"copy"};
+        static constexpr std::string_view label {"Copy kernel"};
+        static constexpr int passes {2}; // c = a
+    };
+
+    struct ScaleKernel {
+        static constexpr std::string_view name {"scale"};
+        static constexpr std::string_view label {"Scale kernel"};
+        static constexpr int passes {2}; // b = q * c
+    };
+
+    struct AddKernel {
+        static constexpr std::string_view name {"add"};
+        static constexpr std::string_view label {"Add kernel"};
+        static constexpr int passes {3}; // c = a + b
+    };
+
+    struct TriadKernel {
+        static constexpr std::string_view name {"triad"};
+        static constexpr std::string_view label {"Triad kernel"};
+        static constexpr int passes {3}; // a = b + q * c
+    };
+
+    struct ReadKernel {
+        static constexpr std::string_view name {"read"};
+        static constexpr std::string_view label {"Read kernel"};
+        static constexpr int passes {1}; // sum of a
+    };
+
+    struct WriteKernel {
+        static constexpr std::string_view name {"write"};
+        static constexpr std::string_view label {"Write kernel"};
+        static constexpr int passes {1}; // a = q
+    };
+
+    using Kernel = std::variant<CopyKernel,
+                                ScaleKernel,
+                                AddKernel,
+                                TriadKernel,
+                                ReadKernel,
+                                WriteKernel>;
+
+    [[nodiscard]]
+    std::string_view kernel_name(const Kernel& kernel) noexcept
+    {
+        return visit([](auto tag) noexcept { return tag.name; }, kernel);
+    }
+
+    [[nodiscard]]
+    std::string_view kernel_label(const Kernel& kernel) noexcept
+    {
+        return visit([](auto tag) noexcept { return tag.label; }, kernel);
+    }
+
+    [[nodiscard]]
+    int kernel_passes(const Kernel& kernel) noexcept
+    {
+        return visit([](auto tag) noexcept { return tag.passes; }, kernel);
+    }
+
+    // Ways to time dependent loads by chasing pointers (see --latency).
+    struct LatencyIdle {
+        static constexpr std::string_view name {"idle"};
+    };
+
+    struct LatencyLoaded {
+        static constexpr std::string_view name {"loaded"};
+    };
+
+    using LatencyMode = std::variant<LatencyIdle, LatencyLoaded>;
+
+    [[nodiscard]]
+    std::string_view latency_name(const LatencyMode& latency) noexcept
+    {
+        return visit([](auto tag) noexcept { return tag.name; }, latency);
+    }
+
+    // Elements per run of an external sort, unless --run-length says.
+    constexpr std::size_t default_run_length {std::size_t{1} << 24};
+
+    // Dependent loads each pointer-chasing stage times, whatever the length.
+    constexpr std::size_t chase_loads {std::size_t{1} << 24};
+
+    // Ways to allocate and initialize the array (see --alloc).
+    struct DefaultAlloc {
+        static constexpr std::string_view name {"default"};
+    };
+
+    struct UninitAlloc {
+        static constexpr std::string_view name {"uninit"};
+    };
+
+    struct HugePageAlloc {
+        static constexpr std::string_view name {"hugepage"};
+    };
+
+    struct PrefaultAlloc {
+        static constexpr std::string_view name {"prefault"};
+    };
+
+    struct MmapAlloc {
+        static constexpr std::string_view name {"mmap"};
+    };
+
+    using AllocMode = std::variant<DefaultAlloc,
+                                   UninitAlloc,
+                                   HugePageAlloc,
+                                   PrefaultAlloc,
+                                   MmapAlloc>;
+
+    [[nodiscard]]
+    std::string_view alloc_name(const AllocMode& alloc) noexcept
+    {
+        return visit([](auto tag) noexcept { return tag.name; }, alloc);
+    }
+
+    // Orders to pin threads to CPUs in (see --pin).
+    struct PinCompact {
+        static constexpr std::string_view name {"compact"};
+    };
+
+    struct PinScatter {
+        static constexpr std::string_view name {"scatter"};
+    };
+
+    struct PinList {
+        static constexpr std::string_view name {"list"};
+    };
+
+    using PinMode = std::variant<PinCompact, PinScatter, PinList>;
+
+    [[nodiscard]]
+    std::string_view pin_name(const PinMode& pin) noexcept
+    {
+        return visit([](auto tag) noexcept { return tag.name; }, pin);
+    }
+
+    // Ways to place the array's pages on NUMA nodes (see --numa).
+    struct NumaLocal {
+        static constexpr std::string_view name {"local"};
+    };
+
+    struct NumaInterleave {
+        static constexpr std::string_view name {"interleave"};
+    };
+
+    struct NumaFirstTouch {
+        static constexpr std::string_view name {"firsttouch"};
+    };
+
+    using NumaMode = std::variant<NumaLocal, NumaInterleave, NumaFirstTouch>;
+
+    [[nodiscard]]
+    std::string_view numa_name(const NumaMode& numa) noexcept
+    {
+        return visit([](auto tag) noexcept { return tag.name; }, numa);
+    }
+
+    // Hints for how a mapped array will be accessed (see --madvise).
+    struct AdviseSequential {
+        static constexpr std::string_view name {"sequential"};
+    };
+
+    struct AdviseRandom {
+        static constexpr std::string_view name {"random"};
+    };
+
+    struct AdviseWillNeed {
+        static constexpr std::string_view name {"willneed"};
+    };
+
+    using Advice = std::variant<AdviseSequential, AdviseRandom, AdviseWillNeed>;
+
+    [[nodiscard]]
+    std::string_view advice_name(const Advice& advice) noexcept
+    {
+        return visit([](auto tag) noexcept { return tag.name; }, advice);
+    }
+
+    // Distributions of input (see --distribution). Some have parameters.
+    struct Uniform {
+        static constexpr std::string_view name {"uniform"};
+    };
+
+    struct Sorted {
+        static constexpr std::string_view name {"sorted"};
+    };
+
+    struct Reversed {
+        static constexpr std::string_view name {"reverse"};
+    };
+
+    struct NearlySorted {
+        static constexpr std::string_view name {"nearly-sorted"};
+        double swap_percent {1.0};
+    };
+
+    struct FewUnique {
+        static constexpr std::string_view name {"few-unique"};
+        std::uint64_t count {16u};
+    };
+
+    struct Zipf {
+        static constexpr std::string_view name {"zipf"};
+        double exponent {1.0};
+    };
+
+    struct OrganPipe {
+        static constexpr std::string_view name {"organ-pipe"};
+    };
+
+    using Distribution = std::variant<Uniform,
+                                      Sorted,
+                                      Reversed,
+                                      NearlySorted,
+                                      FewUnique,
+                                      Zipf,
+                                      OrganPipe>;
+
+    [[nodiscard]]
+    std::string_view distribution_name(const Distribution& dist) noexcept
+    {
+        return visit([](const auto& tag) noexcept { return tag.name; }, dist);
+    }
+
+    // Ways to disorder a sorted array by a fraction, to see how sorting it
+    // again depends on how far it's from sorted (see --perturb).
+    struct PerturbSwaps {
+        static constexpr std::string_view name {"swaps"};
+    };
+
+    struct PerturbTail {
+        static constexpr std::string_view name {"tail"};
+    };
+
+    struct PerturbReverse {
+        static constexpr std::string_view name {"reverse"};
+    };
+
+    using Perturbation = std::variant<PerturbSwaps,
+                                      PerturbTail,
+                                      PerturbReverse>;
+
+    [[nodiscard]]
+    std::string_view perturbation_name(const Perturbation& how) noexcept
+    {
+        return visit([](const auto& tag) noexcept { return tag.name; }, how);
+    }
+
+    // Ways to write results, besides the human-readable progress and summary.
+    enum class OutputFormat {
+        text, // only human-readable text
+        json, // a JSON object with parameters, host information, and results
+        csv,  // a CSV table with a record for each stage of each trial
+    };
+}
+
+// ParallelMode http://fmtlib.net/dev/api.html#formatting-user-defined-types
+namespace fmt {
+    template<>
+    struct formatter<ParallelMode> {
+        template<typename ParseContext>
+        constexpr auto parse(ParseContext& ctx) { return std::begin(ctx); }
+
+        template<typename FormatContext>
+        auto format(const ParallelMode& mode, FormatContext& ctx)
+        {
+            const auto summary = visit(MultiLambda{
+                [](sequenced_policy) noexcept {
+                    return "std::execution::seq (do not parallelize)";
+                },
+                [](parallel_policy) noexcept {
+                    return "std::execution::par (parallelize)";
+                },
+                [](parallel_unsequenced_policy) noexcept {
+                    return "std::execution::par_unseq"
+                           " (parallelize/vectorize/migrate)";
+                },
+                [](pool_policy) noexcept {
+                    return "pmb::par (parallelize on the work-stealing pool)";
+                }
+            }, mode);
+
+            return format_to(std::begin(ctx), "{}", summary);
+        }
+    };
+}
+
+// ElementType http://fmtlib.net/dev/api.html#formatting-user-defined-types
+namespace fmt {
+    template<>
+    struct formatter<ElementType> {
+        template<typename ParseContext>
+        constexpr auto parse(ParseContext& ctx) { return std::begin(ctx); }
+
+        template<typename FormatContext>
+        auto format(const ElementType& type, FormatContext& ctx)
+        {
+            return visit([&](auto tag) {
+                using T = typename decltype(tag)::type;
+
+                return format_to(std::begin(ctx), "{} ({}-bit {})", tag.name,
+                                 sizeof(T) * CHAR_BIT,
+                                 ElementTraits<T>::description);
+            }, type);
+        }
+    };
+}
+
+// SortAlgorithm http://fmtlib.net/dev/api.html#formatting-user-defined-types
+namespace fmt {
+    template<>
+    struct formatter<SortAlgorithm> {
+        template<typename ParseContext>
+        constexpr auto parse(ParseContext& ctx) { return std::begin(ctx); }
+
+        template<typename FormatContext>
+        auto format(const SortAlgorithm& algorithm, FormatContext& ctx)
+        {
+            const auto summary = visit(MultiLambda{
+                [](StdSort) noexcept {
+                    return "std::sort (in place, typically introsort)";
+                },
+                [](StableSort) noexcept {
+                    return "std::stable_sort (typically merge sort, buffered)";
+                },
+                [](PartialSort) noexcept {
+                    return "std::partial_sort (sorts up to the middle)";
+                },
+                [](NthElement) noexcept {
+                    return "std::nth_element (partitions at the middle)";
+                },
+                [](MergeSort) noexcept {
+                    return "merge sort (sorted runs, std::inplace_merge)";
+                },
+                [](RadixSort) noexcept {
+                    return "LSD radix sort (8-bit digits, out of place)";
+                },
+                [](SampleSort) noexcept {
+                    return "samplesort (sampled splitters, out of place)";
+                }
+            }, algorithm);
+
+            return format_to(std::begin(ctx), "{}", summary);
+        }
+    };
+}
+
+// AllocMode http://fmtlib.net/dev/api.html#formatting-user-defined-types
+namespace fmt {
+    template<>
+    struct formatter<AllocMode> {
+        template<typename ParseContext>
+        constexpr auto parse(ParseContext& ctx) { return std::begin(ctx); }
+
+        template<typename FormatContext>
+        auto format(const AllocMode& alloc, FormatContext& ctx)
+        {
+            const auto summary = visit(MultiLambda{
+                [](DefaultAlloc) noexcept {
+                    return "default (operator new, value-initialized)";
+                },
+                [](UninitAlloc) noexcept {
+                    return "uninit (operator new, not initialized)";
+                },
+                [](HugePageAlloc) noexcept {
+                    return "hugepage (mapped, huge pages, faulted lazily)";
+                },
+                [](PrefaultAlloc) noexcept {
+                    return "prefault (mapped, faulted in the sort's mode)";
+                },
+                [](MmapAlloc) noexcept {
+                    return "mmap (mapped, faulted lazily)";
+                }
+            }, alloc);
+
+            return format_to(std::begin(ctx), "{}", summary);
+        }
+    };
+}
+
+// NumaMode http://fmtlib.net/dev/api.html#formatting-user-defined-types
+namespace fmt {
+    template<>
+    struct formatter<NumaMode> {
+        template<typename ParseContext>
+        constexpr auto parse(ParseContext& ctx) { return std::begin(ctx); }
+
+        template<typename FormatContext>
+        auto format(const NumaMode& numa, FormatContext& ctx)
+        {
+            const auto summary = visit(MultiLambda{
+                [](NumaLocal) noexcept {
+                    return "local (bound to the main thread's node)";
+                },
+                [](NumaInterleave) noexcept {
+                    return "interleave (pages interleaved across nodes)";
+                },
+                [](NumaFirstTouch) noexcept {
+                    return "firsttouch (zeroed by threads pinned to each node)";
+                }
+            }, numa);
+
+            return format_to(std::begin(ctx), "{}", summary);
+        }
+    };
+}
+
+// Distribution http://fmtlib.net/dev/api.html#formatting-user-defined-types
+namespace fmt {
+    template<>
+    struct formatter<Distribution> {
+        template<typename ParseContext>
+        constexpr auto parse(ParseContext& ctx) { return std::begin(ctx); }
+
+        template<typename FormatContext>
+        auto format(const Distribution& dist, FormatContext& ctx)
+        {
+            const auto out = std::begin(ctx);
+
+            return visit(MultiLambda{
+                [out](Uniform) {
+                    return format_to(out, "uniform (independent elements)");
+                },
+                [out](Sorted) {
+                    return format_to(out, "sorted (ascending)");
+                },
+                [out](Reversed) {
+                    return format_to(out, "reverse (sorted descending)");
+                },
+                [out](const NearlySorted& d) {
+                    return format_to(out, "nearly sorted ({}% swapped)",
+                                     d.swap_percent);
+                },
+                [out](const FewUnique& d) {
+                    return format_to(out, "few unique ({} distinct values)",
+                                     d.count);
+                },
+                [out](const Zipf& d) {
+                    return format_to(out, "Zipf (exponent {})", d.exponent);
+                },
+                [out](OrganPipe) {
+                    return format_to(out, "organ pipe (ascending, then"
+                                          " descending)");
+                }
+            }, dist);
+        }
+    };
+}
+
+namespace {
+    // Formattable names of specific configuration parameters (see Parameters).
+    struct ParameterLabel {
+        static constexpr auto width = 9;
+
+        std::string_view name;
+    };
+
+    [[nodiscard]]
+    constexpr ParameterLabel
+    operator""_pl(const char* const s, const std::size_t count)
+    {
+        return {{s, count}};
+    }
+}
+
+// ParameterLabel http://fmtlib.net/dev/api.html#formatting-user-defined-types
+namespace fmt {
+    template<>
+    struct formatter<ParameterLabel> {
+        template<typename ParseContext>
+        constexpr auto parse(ParseContext& ctx) { return std::begin(ctx); }
+
+        template<typename FormatContext>
+        auto format(const ParameterLabel label, FormatContext& ctx)
+        {
+            return format_to(std::begin(ctx), "{:>{}}:  ", // right-justified
+                             label.name, ParameterLabel::width);
+        }
+    };
+}
+
+namespace {
+    // Configuration parameters that control a run.
+    struct Parameters {
+        static constexpr auto label_width = 9;
+
+        std::size_t length; // the largest, if sweeping
+        std::vector<std::size_t> length_sweep;
+        ElementType element_type;
+        unsigned seed;
+        std::string_view seed_origin;
+        Distribution distribution;
+        SortAlgorithm algorithm;
+        double middle;
+        std::size_t buckets; // for samplesort, or 0 to size them by cache
+        std::uint64_t bucket_bytes; // about how big buckets are, if sized
+        ParallelMode mode;
+        AllocMode alloc;
+        std::optional<Advice> advice;
+        std::optional<std::filesystem::path> input; // mapped instead of made
+        std::optional<std::filesystem::path> output; // saves what's made
+        std::optional<NumaMode> numa;
+        std::optional<PinMode> pin;
+        std::vector<unsigned> pin_cpus; // thread i runs on pin_cpus[i % size]
+        unsigned threads; // 0 if not limited
+        std::vector<unsigned> thread_sweep;
+        bool counters;
+        std::vector<Kernel> kernels; // run after the sort, in this order
+        std::optional<LatencyMode> latency;
+        std::optional<std::filesystem::path> external; // where runs go
+        std::size_t run_length; // elements per run, if external
+        bool blockwise_generation;
+        int inplace_reps;
+        int trials;
+        int warmups;
+        int instances; // tests running at once, each with its own array
+        double duration; // seconds instances repeat for, or 0 to do trials
+        double soak; // seconds to repeat and compare tests for, or 0
+        int pipeline; // buffers trials go through at once, or 0 if not
+        std::optional<Perturbation> perturbation; // to sort again after
+        std::vector<double> perturb_levels; // fractions perturbed, in order
+        OutputFormat format;
+        std::optional<std::filesystem::path> save_baseline; // results as JSON
+        std::optional<std::filesystem::path> compare; // a saved baseline
+        double threshold; // fraction slower a stage regresses past
+        std::optional<std::filesystem::path> sample; // time series as CSV
+        std::chrono::milliseconds sample_interval;
+        bool show_start_time;
+    };
+
+    // Helper for fmt::formatter<Parameters>::format. Prints timestamp.
+    template<typename OutputIt>
+    [[nodiscard]]
+    OutputIt format_localnow_to(const OutputIt out)
+    {
+        // Obtain the current time.
+        using clock = std::chrono::system_clock;
+        const auto time = fmt::localtime(clock::to_time_t(clock::now()));
+
+        // Convert it to a string, then use that string (see below for why).
+        const auto repr = fmt::format("{:%T%z}", time);
+        return fmt::format_to(out, "Current time is {}.\n", repr);
+
+        // The code shown below crashes or behaves erratically. It appears to
+        // (try to) write past the end of a buffer. Perhaps someone will point
+        // out my mistake or a bug in fmtlib. For now, I am working around it
+        // with the ugly hack that appears above.
+        //
+        // return fmt::format_to(out, "Current time is {:%T%z}.\n", time);
+    }
+
+    // Helper for fmt::formatter<Parameters>::format. Prints array length.
+    template<typename OutputIt>
+    [[nodiscard]]
+    OutputIt format_length_to(const OutputIt out, const std::size_t length,
+                              const std::size_t element_size)
+    {
+        static constexpr std::size_t kilo {1024u}, mega {kilo * kilo};
+
+        const auto bytes = length * element_size;
+
+        return fmt::format_to(out, "{}{} element{} ({}{} MiB)\n",
+                              "length"_pl, length, (length == 1u ? "" : "s"),
+                              (bytes % mega == 0u ? "" : "~"), bytes / mega);
+    }
+
+    // Helper for fmt::formatter<Parameters>::format. Prints lengths to sweep.
+    template<typename OutputIt>
+    [[nodiscard]]
+    OutputIt format_length_sweep_to(const OutputIt out,
+                                    const std::vector<std::size_t>& lengths,
+                                    const std::size_t element_size)
+    {
+        static constexpr std::size_t kilo {1024u};
+
+        assert(!lengths.empty());
+        const auto bytes = lengths.back() * element_size;
+
+        return fmt::format_to(out, "{}{} to {} elements, {} size{}"
+                                   "  (sweep, up to {}{} KiB)\n",
+                              "length"_pl, lengths.front(), lengths.back(),
+                              lengths.size(), (lengths.size() == 1u ? "" : "s"),
+                              (bytes % kilo == 0u ? "" : "~"), bytes / kilo);
+    }
+}
+
+// Parameters http://fmtlib.net/dev/api.html#formatting-user-defined-types
+namespace fmt {
+    template<>
+    struct formatter<Parameters> {
+        template<typename ParseContext>
+        constexpr auto parse(ParseContext& ctx) { return std::cbegin(ctx); }
+
+        template<typename FormatContext>
+        auto format(const Parameters& params, FormatContext& ctx)
+        {
+            auto out = std::begin(ctx);
+
+            // Print human-readable current time (and blank line), if requested.
+            if (params.show_start_time) out = format_localnow_to(out);
+
+            // Show the specified length(s) and about how much space to use.
+            if (params.length_sweep.empty()) {
+                out = format_length_to(out, params.length,
+                                       element_size(params.element_type));
+            }
+            else {
+                out = format_length_sweep_to(out, params.length_sweep,
+                                             element_size(params.element_type));
+            }
+
+            // Show what the elements are.
+            out = format_to(out, "{}{}\n", "type"_pl, params.element_type);
+
+            // Show the seed the PRNG will use, and say where it came from.
+            out = format_to(out, "{}{}  ({})\n", "seed"_pl,
+                            params.seed, params.seed_origin);
+
+            // Say what kind of input to make, or what file is the input.
+            if (params.input) {
+                out = format_to(out, "{}{}  (mapped privately)\n", "input"_pl,
+                                params.input->string());
+            }
+            else {
+                out = format_to(out, "{}{}\n", "input"_pl,
+                                params.distribution);
+            }
+            if (params.output) {
+                out = format_to(out, "{}{}  (saves the generated input)\n",
+                                "output"_pl, params.output->string());
+            }
+
+            // Say how the array is allocated.
+            out = format_to(out, "{}{}", "alloc"_pl, params.alloc);
+            if (params.advice) {
+                out = format_to(out, "  [madvise {}]",
+                                advice_name(*params.advice));
+            }
+            out = format_to(out, "\n");
+            if (params.numa)
+                out = format_to(out, "{}{}\n", "numa"_pl, *params.numa);
+
+            // Say how the elements are generated, and if that's parallelized.
+            const auto engine = visit([](auto tag) {
+                using Engine = typename ElementTraits<
+                                    typename decltype(tag)::type>::Engine;
+
+                return (std::is_same_v<Engine, std::mt19937>
+                            ? "std::mt19937" : "std::mt19937_64");
+            }, params.element_type);
+
+            out = format_to(out, "{}{}", "generator"_pl, engine);
+            if (params.blockwise_generation) {
+                out = format_to(out, " per {}-element block  (blockwise)\n",
+                                generation_block_length);
+            }
+            else out = format_to(out, ", one stream  (serial)\n");
+
+            // Name and "explain" the sorting algorithm.
+            out = format_to(out, "{}{}", "algorithm"_pl, params.algorithm);
+            if (uses_middle(params.algorithm))
+                out = format_to(out, "  [middle at {}]", params.middle);
+            if (params.buckets != 0u)
+                out = format_to(out, "  [{} buckets]", params.buckets);
+            else if (params.bucket_bytes != 0u) {
+                out = format_to(out, "  [buckets of about {} KiB]",
+                                params.bucket_bytes >> 10u);
+            }
+            out = format_to(out, "\n");
+
+            // Name and "explain" the execution policy and if we rerun the sort.
+            out = format_to(out, "{}{}", "sort mode"_pl, params.mode);
+            if (params.inplace_reps > 1)
+                out = format_to(out, "  [repeating {}x]", params.inplace_reps);
+            out = format_to(out, "\n");
+
+            // Show which CPUs threads are pinned to, if they are.
+            if (params.pin) {
+                static constexpr std::size_t shown {8u};
+
+                out = format_to(out, "{}{} (CPUs", "pin"_pl,
+                                pin_name(*params.pin));
+                for (std::size_t i = 0u;
+                        i != std::min(params.pin_cpus.size(), shown); ++i)
+                    out = format_to(out, " {}", params.pin_cpus[i]);
+                if (params.pin_cpus.size() > shown)
+                    out = format_to(out, " ...");
+                out = format_to(out, ")\n");
+            }
+
+            // Show which bandwidth kernels run after the sort, if any.
+            if (!params.kernels.empty()) {
+                out = format_to(out, "{}", "kernels"_pl);
+                for (auto p = cbegin(params.kernels);
+                        p != cend(params.kernels); ++p) {
+                    out = format_to(out, "{}{}",
+                                    (p == cbegin(params.kernels) ? "" : ", "),
+                                    kernel_name(*p));
+                }
+                out = format_to(out, "  (STREAM-style, after the sort)\n");
+            }
+
+            // Say how pointer chasing runs after the sort, if it does.
+            if (params.latency) {
+                out = format_to(out, "{}{}, {} dependent loads  ({})\n",
+                                "latency"_pl, "pointer chasing", chase_loads,
+                                visit(MultiLambda{
+                    [](LatencyIdle) { return "idle"; },
+                    [](LatencyLoaded) { return "under copy/scale load"; }
+                }, *params.latency));
+            }
+
+            // Say where and in what runs an external sort goes, if it does.
+            if (params.external) {
+                const auto run_length = std::min(params.run_length,
+                                                 params.length);
+                const auto runs = params.length / run_length
+                                    + (params.length % run_length != 0u);
+
+                out = format_to(out, "{}runs of up to {} elements, in {}"
+                                     "  ({}-way merge)\n",
+                                "external"_pl, run_length,
+                                params.external->string(), runs);
+            }
+
+            // Show thread counts to sweep through, if any.
+            if (!params.thread_sweep.empty()) {
+                out = format_to(out, "{}", "threads"_pl);
+                for (auto p = cbegin(params.thread_sweep);
+                        p != cend(params.thread_sweep); ++p) {
+                    out = format_to(out, "{}{}",
+                                    (p == cbegin(params.thread_sweep) ? ""
+                                                                      : ", "),
+                                    *p);
+                }
+                out = format_to(out, "  (sweep, after a seq baseline)\n");
+            }
+
+            // Show how many times the whole test runs, if more than once.
+            if (params.trials > 1 || params.warmups > 0) {
+                out = format_to(out, "{}{}", "trials"_pl, params.trials);
+                if (params.warmups > 0) {
+                    out = format_to(out, "  (after {} warmup{})",
+                                    params.warmups,
+                                    (params.warmups == 1 ? "" : "s"));
+                }
+                out = format_to(out, "\n");
+            }
+
+            // Show how many tests run at once, and for how long.
+            if (params.instances > 1) {
+                out = format_to(out, "{}{} at once, seeds from the seed",
+                                "instances"_pl, params.instances);
+                if (params.duration > 0.0) {
+                    out = format_to(out, "  (repeating for {} s)",
+                                    params.duration);
+                }
+                out = format_to(out, "\n");
+            }
+
+            if (params.soak > 0.0) {
+                out = format_to(out,
+                                "{}{} s  (generate, sort, verify, repeat)\n",
+                                "soak"_pl, params.soak);
+            }
+
+            if (params.save_baseline) {
+                out = format_to(out, "{}saving to {}\n", "baseline"_pl,
+                                params.save_baseline->string());
+            }
+
+            if (params.compare) {
+                out = format_to(out, "{}{}  (regressing past {}% fails)\n",
+                                "compare"_pl, params.compare->string(),
+                                params.threshold * 100.0);
+            }
+
+            if (params.sample) {
+                out = format_to(out, "{}{} every {} ms\n", "sample"_pl,
+                                params.sample->string(),
+                                params.sample_interval.count());
+            }
+
+            if (params.pipeline > 0) {
+                out = format_to(out,
+                                "{}{} buffers  (generate, sort, and verify"
+                                " overlap)\n",
+                                "pipeline"_pl, params.pipeline);
+            }
+
+            if (params.perturbation) {
+                out = format_to(out, "{}{} at", "perturb"_pl,
+                                perturbation_name(*params.perturbation));
+                const char* separator = " ";
+                for (const auto level : params.perturb_levels) {
+                    out = format_to(out, "{}{:g}%",
+                                    std::exchange(separator, ", "),
+                                    level * 100.0);
+                }
+                out = format_to(out, "  (then count inversions and sort)\n");
+            }
+
+            return out;
+        }
+    };
+}
+
+namespace {
+    // The machine's CPUs, caches, and NUMA nodes, as sysfs describes them, and
+    // restricting threads to CPUs. Detection finds nothing except on Linux.
+    namespace topology {
+        // A node's number, and the numbers of its CPUs.
+        struct Node {
+            unsigned id;
+            std::vector<unsigned> cpus;
+        };
+
+        // A logical CPU, and the socket (package) and core it belongs to.
+        struct Cpu {
+            unsigned id;
+            unsigned package;
+            unsigned core;
+        };
+
+        // A cache of the first CPU, and how many CPUs share it.
+        struct Cache {
+            unsigned level;
+            std::string type;
+            std::uint64_t bytes;
+            std::size_t shared_by;
+        };
+
+        struct Topology {
+            std::vector<Cpu> cpus;
+            std::vector<Cache> caches;
+            std::vector<Node> nodes;
+        };
+
+        // Parses a list of ranges such as "0-3,8-11".
+        [[nodiscard]]
+        std::vector<unsigned> parse_cpu_list(const std::string& list)
+        {
+            std::vector<unsigned> cpus;
+            std::stringstream in {list};
+
+            for (std::string item; std::getline(in, item, ','); ) {
+                if (item.empty() || item == "\n") continue;
+                const auto dash = item.find('-');
+                const auto lo = std::stoul(item.substr(0u, dash));
+                const auto hi = (dash == std::string::npos
+                                    ? lo : std::stoul(item.substr(dash + 1u)));
+                for (auto cpu = lo; cpu <= hi; ++cpu)
+                    cpus.push_back(static_cast<unsigned>(cpu));
+            }
+
+            return cpus;
+        }
+
+        // A bit mask of nodes or CPUs, in the kernel's format.
+        using Mask = std::vector<unsigned long>;
+
+        constexpr auto mask_bits = sizeof(unsigned long) * CHAR_BIT;
+
+        [[nodiscard]]
+        Mask make_mask(const std::vector<unsigned>& ids)
+        {
+            Mask mask;
+
+            for (const auto id : ids) {
+                if (mask.size() <= id / mask_bits)
+                    mask.resize(id / mask_bits + 1u);
+                mask[id / mask_bits] |= 1ul << (id % mask_bits);
+            }
+
+            return mask;
+        }
+
+        // Reads the first line of a file, or returns an empty string.
+        [[nodiscard]]
+        std::string read_line(const std::filesystem::path& path)
+        {
+            std::ifstream in {path};
+            std::string line;
+            std::getline(in, line);
+            return line;
+        }
+
+        // Finds the nodes with CPUs, in order. It's empty if that's unknown.
+        [[nodiscard]]
+        std::vector<Node> nodes()
+        {
+            namespace fs = std::filesystem;
+            static constexpr std::string_view prefix {"node"};
+
+            std::vector<Node> ret;
+            std::error_code ec;
+
+            for (const auto& entry
+                    : fs::directory_iterator{"/sys/devices/system/node", ec}) {
+                const auto name = entry.path().filename().string();
+                if (name.compare(0u, prefix.size(), prefix) != 0
+                        || !std::isdigit(static_cast<unsigned char>(
+                                            name[prefix.size()])))
+                    continue;
+
+                auto cpus = parse_cpu_list(read_line(entry.path() / "cpulist"));
+                if (cpus.empty()) continue;
+
+                ret.push_back({static_cast<unsigned>(
+                                    std::stoul(name.substr(prefix.size()))),
+                               std::move(cpus)});
+            }
+
+            std::sort(begin(ret), end(ret), [](const Node& a, const Node& b) {
+                return a.id < b.id;
+            });
+
+            return ret;
+        }
+
+        // Parses a size such as "32K", as sysfs shows cache sizes.
+        [[nodiscard]]
+        std::uint64_t parse_size(const std::string& text)
+        {
+            std::size_t pos {};
+            auto bytes = std::uint64_t{std::stoull(text, &pos)};
+
+            if (pos < text.size()) {
+                switch (text[pos]) {
+                case 'K': bytes <<= 10u; break;
+                case 'M': bytes <<= 20u; break;
+                case 'G': bytes <<= 30u; break;
+                default: break;
+                }
+            }
+
+            return bytes;
+        }
+
+        [[nodiscard]]
+        Topology detect()
+        {
+            namespace fs = std::filesystem;
+            const fs::path root {"/sys/devices/system/cpu"};
+
+            Topology topo;
+
+            try {
+                const auto online = parse_cpu_list(read_line(root / "online"));
+                for (const auto id : online) {
+                    const auto dir = root / fmt::format("cpu{}", id)
+                                          / "topology";
+                    const auto package = read_line(dir / "physical_package_id");
+                    const auto core = read_line(dir / "core_id");
+                    if (package.empty() || core.empty()) continue;
+
+                    topo.cpus.push_back({id,
+                                         static_cast<unsigned>(
+                                            std::stoul(package)),
+                                         static_cast<unsigned>(
+                                            std::stoul(core))});
+                }
+
+                std::error_code ec;
+                for (const auto& entry
+                        : fs::directory_iterator{root / "cpu0" / "cache", ec}) {
+                    const auto level = read_line(entry.path() / "level");
+                    const auto size = read_line(entry.path() / "size");
+                    if (level.empty() || size.empty()) continue;
+
+                    topo.caches.push_back({
+                        static_cast<unsigned>(std::stoul(level)),
+                        read_line(entry.path() / "type"), parse_size(size),
+                        parse_cpu_list(read_line(entry.path()
+                                                 / "shared_cpu_list")).size()
+                    });
+                }
+            }
+            catch (const std::logic_error&) {
+                // Some file was malformed. Report what was read before it.
+            }
+
+            std::sort(begin(topo.caches), end(topo.caches),
+                      [](const Cache& a, const Cache& b) {
+                return std::tie(a.level, a.type) < std::tie(b.level, b.type);
+            });
+
+            topo.nodes = nodes();
+            return topo;
+        }
+
+        [[nodiscard]]
+        std::size_t package_count(const Topology& topo)
+        {
+            std::vector<unsigned> packages;
+            for (const auto& cpu : topo.cpus) packages.push_back(cpu.package);
+            std::sort(begin(packages), end(packages));
+            return static_cast<std::size_t>(
+                    std::unique(begin(packages), end(packages))
+                        - begin(packages));
+        }
+
+        [[nodiscard]]
+        std::size_t core_count(const Topology& topo)
+        {
+            std::vector<std::pair<unsigned, unsigned>> cores;
+            for (const auto& cpu : topo.cpus)
+                cores.emplace_back(cpu.package, cpu.core);
+            std::sort(begin(cores), end(cores));
+            return static_cast<std::size_t>(
+                    std::unique(begin(cores), end(cores)) - begin(cores));
+        }
+
+        // Orders CPUs to fill each core's SMT siblings, then each socket's
+        // cores, before the next socket.
+        [[nodiscard]]
+        std::vector<unsigned> compact_order(const Topology& topo)
+        {
+            auto cpus = topo.cpus;
+            std::sort(begin(cpus), end(cpus), [](const Cpu& a, const Cpu& b) {
+                return std::tie(a.package, a.core, a.id)
+                        < std::tie(b.package, b.core, b.id);
+            });
+
+            std::vector<unsigned> order;
+            for (const auto& cpu : cpus) order.push_back(cpu.id);
+            return order;
+        }
+
+        // Orders CPUs to use one SMT sibling of every core first, going round
+        // the sockets, so threads share as little as possible.
+        [[nodiscard]]
+        std::vector<unsigned> scatter_order(const Topology& topo)
+        {
+            const auto compact = compact_order(topo);
+
+            // Rank each CPU among its core's siblings, and its core among its
+            // socket's cores, from the compact order.
+            struct Ranked {
+                std::size_t sibling, core;
+                unsigned package, id;
+            };
+
+            std::vector<Ranked> ranked;
+            std::size_t sibling {}, core {};
+
+            for (std::size_t i = 0u; i != compact.size(); ++i) {
+                const auto& cpu = *std::find_if(
+                    cbegin(topo.cpus), cend(topo.cpus),
+                    [&](const Cpu& c) { return c.id == compact[i]; });
+
+                if (i != 0u) {
+                    const auto& prev = ranked.back();
+                    const auto& prev_cpu = *std::find_if(
+                        cbegin(topo.cpus), cend(topo.cpus),
+                        [&](const Cpu& c) { return c.id == prev.id; });
+
+                    if (cpu.package != prev_cpu.package) {
+                        sibling = core = 0u;
+                    }
+                    else if (cpu.core != prev_cpu.core) {
+                        sibling = 0u;
+                        ++core;
+                    }
+                    else ++sibling;
+                }
+
+                ranked.push_back({sibling, core, cpu.package, cpu.id});
+            }
+
+            std::sort(begin(ranked), end(ranked),
+                      [](const Ranked& a, const Ranked& b) {
+                return std::tie(a.sibling, a.core, a.package, a.id)
+                        < std::tie(b.sibling, b.core, b.package, b.id);
+            });
+
+            std::vector<unsigned> order;
+            for (const auto& cpu : ranked) order.push_back(cpu.id);
+            return order;
+        }
+
+        // Lists the caches, like "L1d 32 KiB, L1i 32 KiB, L2 1 MiB".
+        [[nodiscard]]
+        std::string describe_caches(const Topology& topo)
+        {
+            std::string ret;
+
+            for (const auto& cache : topo.caches) {
+                const auto kind = (cache.type == "Data" ? "d"
+                                    : cache.type == "Instruction" ? "i" : "");
+                const auto mib = (cache.bytes % (1u << 20) == 0u);
+
+                ret += fmt::format("{}L{}{} {} {}", (ret.empty() ? "" : ", "),
+                                   cache.level, kind,
+                                   cache.bytes >> (mib ? 20u : 10u),
+                                   (mib ? "MiB" : "KiB"));
+                if (cache.shared_by > 1u)
+                    ret += fmt::format(" (per {} CPUs)", cache.shared_by);
+            }
+
+            return ret;
+        }
+
+#ifdef PMB_HAVE_NUMA
+        // Restricts the calling thread to some CPUs.
+        void pin_current_thread(const std::vector<unsigned>& cpus) noexcept
+        {
+            const auto mask = make_mask(cpus);
+            ::syscall(SYS_sched_setaffinity, 0, mask.size() * sizeof(mask[0]),
+                      mask.data());
+        }
+
+#endif
+    }
+}
+
+// Topology http://fmtlib.net/dev/api.html#formatting-user-defined-types
+namespace fmt {
+    template<>
+    struct formatter<topology::Topology> {
+        template<typename ParseContext>
+        constexpr auto parse(ParseContext& ctx) { return std::begin(ctx); }
+
+        template<typename FormatContext>
+        auto format(const topology::Topology& topo, FormatContext& ctx)
+        {
+            auto out = std::begin(ctx);
+
+            if (topo.cpus.empty())
+                return format_to(out, "{}unknown\n", "topology"_pl);
+
+            const auto plural = [](const std::size_t n) {
+                return (n == 1u ? "" : "s");
+            };
+
+            const auto packages = topology::package_count(topo);
+            const auto cores = topology::core_count(topo);
+            const auto cpus = topo.cpus.size();
+            const auto nodes = topo.nodes.size();
+
+            out = format_to(out, "{}{} socket{}, {} core{}, {} CPU{}",
+                            "topology"_pl, packages, plural(packages),
+                            cores, plural(cores), cpus, plural(cpus));
+            if (cpus > cores && cpus % cores == 0u)
+                out = format_to(out, " ({}-way SMT)", cpus / cores);
+            if (nodes != 0u) {
+                out = format_to(out, ", {} NUMA node{}",
+                                nodes, plural(nodes));
+            }
+            out = format_to(out, "\n");
+
+            if (!topo.caches.empty()) {
+                out = format_to(out, "{}{}\n", "caches"_pl,
+                                topology::describe_caches(topo));
+            }
+
+            return out;
+        }
+    };
+}
+
+namespace {
+    [[nodiscard]]
+    std::tuple<po::options_description, po::positional_options_description>
+    describe_options()
+    {
+        po::options_description desc {"Options to configure the benchmark"};
+        desc.add_options()
+                ("help,h", "show this message") // TODO: list --help separately
+                ("list-kernels", "list the sorting kernels (element type,"
+                                 " algorithm, and policy) this build has")
+                ("length,l", po::value<std::size_t>(),
+                             "specify how many elements to generate and sort")
+                ("length-sweep", po::value<std::string>(),
+                                 "START:END:FACTOR to run at lengths from START"
+                                 " to END, each FACTOR times the last")
+                ("type,T", po::value<std::string>(),
+                           "element type: u32 (default), u64, f32, f64, kv64,"
+                           " kv128")
+                ("seed,s", po::value<unsigned>(),
+                           "custom seed for PRNG (omit to use system entropy)")
+                ("distribution,d", po::value<std::string>(),
+                                   "input: uniform (default), sorted, reverse,"
+                                   " nearly-sorted, few-unique, zipf,"
+                                   " organ-pipe")
+                ("swaps", po::value<double>(),
+                          "percent of elements nearly-sorted swaps (default 1)")
+                ("unique", po::value<std::uint64_t>(),
+                           "how many values few-unique has (default 16)")
+                ("zipf-exponent", po::value<double>(),
+                                  "exponent of the zipf distribution"
+                                  " (default 1)")
+                ("alloc", po::value<std::string>(),
+                          "allocation: default, uninit, hugepage, prefault,"
+                          " mmap")
+                ("madvise", po::value<std::string>(),
+                            "hint how mapped allocations are accessed:"
+                            " sequential, random, willneed")
+                ("input", po::value<std::string>(),
+                          "map this file of raw elements as the array,"
+                          " instead of generating one")
+                ("output", po::value<std::string>(),
+                           "map this file as the array, to save the generated"
+                           " input (then sort privately)")
+                ("numa", po::value<std::string>(),
+                         "NUMA placement: local, interleave, firsttouch"
+                         " (implies --alloc mmap)")
+                ("blocks,b", "generate in seeded blocks, in the sort's mode")
+                ("algorithm,a", po::value<std::string>(),
+                                "sort algorithm: sort (default), stable,"
+                                " partial, nth, merge, radix, sample")
+                ("middle,m", po::value<double>(),
+                             "where partial and nth divide the array, as a"
+                             " fraction of its length (default 0.5)")
+                ("buckets", po::value<std::size_t>(),
+                            "buckets for sample (default: enough that each"
+                            " fits in L2)")
+                ("twice,2", "after sorting, sort again (may test adaptivity)")
+                ("perturb", po::value<std::string>(),
+                            "after sorting, perturb the array and sort again,"
+                            " at each --perturb-levels: swaps (random pairs),"
+                            " tail (moved to the end, unsorted), reverse"
+                            " (segments reversed)")
+                ("perturb-levels", po::value<std::string>(),
+                                   "comma-separated fractions of the array to"
+                                   " perturb (default 0.001,0.01,0.1)")
+                ("trials,n", po::value<int>(),
+                             "run the test this many times, and summarize")
+                ("warmup,w", po::value<int>(),
+                             "first run the test this many unmeasured times")
+                ("instances", po::value<int>(),
+                              "run this many tests at once, on separate arrays"
+                              " (a stress test)")
+                ("duration", po::value<double>(),
+                             "repeat each instance's test for this many"
+                             " seconds, instead of running trials")
+                ("soak", po::value<std::string>(),
+                         "repeat the test for this long (like 90s, 30m, 8h),"
+                         " checking each block against the first test")
+                ("pipeline", po::value<int>(),
+                             "overlap trials through this many buffers (at"
+                             " least 2): generate the next trial's input and"
+                             " verify the last one's output while sorting")
+                ("sample", po::value<std::string>(),
+                           "sample RSS, CPU use, and (with --counters) LLC"
+                           " miss traffic while running, writing a CSV time"
+                           " series to this file, and show long stages'"
+                           " progress")
+                ("sample-interval", po::value<int>(),
+                                    "milliseconds between samples (default"
+                                    " 100)")
+                ("kernel", po::value<std::string>(),
+                           "after sorting, time bandwidth kernels: a"
+                           " comma-separated list of copy, scale, add, triad,"
+                           " read, write, or all")
+                ("latency", po::value<std::string>(),
+                            "after sorting, time dependent loads by chasing"
+                            " pointers through a random cycle: idle, or"
+                            " loaded (while other threads copy and scale)")
+                ("external", po::value<std::string>(),
+                             "sort out of core: sort runs in memory, write"
+                             " them to files in this directory, and merge"
+                             " them")
+                ("run-length", po::value<std::size_t>(),
+                               "elements per run of --external (default"
+                               " 16777216)")
+                ("counters", "count cycles, instructions, and LLC, dTLB, and"
+                             " branch misses in each stage")
+                ("time,t", "display human-readable start time")
+                ("format,f", po::value<std::string>(),
+                             "also write results to stdout as json or csv")
+                ("save-baseline", po::value<std::string>(),
+                                  "also write the results (as json) to this"
+                                  " file, for --compare")
+                ("compare", po::value<std::string>(),
+                            "compare stages with a file from --save-baseline,"
+                            " exiting with status 2 if any regress")
+                ("threshold", po::value<double>(),
+                              "how many percent slower a stage regresses past,"
+                              " if it's significant (default 5)")
+                ("seq,S", "don't try to parallelize")
+                ("par,P", "try to parallelize (default)")
+                ("par-unseq,U",
+                        "try to parallelize, may migrate thread and vectorize")
+                ("pmb-par", "parallelize on this program's work-stealing pool")
+                ("pin", po::value<std::string>(),
+                        "pin threads to CPUs: compact, scatter, or a list"
+                        " (like 0-3,8)")
+                ("threads,j", po::value<std::string>(),
+                              "comma-separated thread counts to sweep through,"
+                              " after a seq baseline");
+
+        po::positional_options_description pos_desc;
+        pos_desc.add("length", 1);
+
+        return {desc, pos_desc};
+    }
+
+    [[nodiscard]]
+    po::variables_map
+    parse_cmdline_args(const int argc,
+                       const gsl::not_null<const char* const*> argv)
+    {
+        const auto [desc, pos_desc] = describe_options();
+
+        po::variables_map vm;
+        try {
+            po::store(po::command_line_parser{argc, argv}
+                        .options(desc).positional(pos_desc).run(), vm);
+        }
+        catch (const po::error& e) {
+            die(e.what());
+        }
+        po::notify(vm);
+
+        if (vm.count("help")) {
+            fmt::print("{}", desc);
+            std::exit(EXIT_SUCCESS);
+        }
+
+        if (vm.count("list-kernels")) {
+            print_sort_kernels();
+            std::exit(EXIT_SUCCESS);
+        }
+
+        return vm;
+    }
+
+    [[nodiscard]]
+    std::size_t extract_length(const po::variables_map& vm,
+                               const std::size_t element_size)
+    {
+        if (!vm.count("length")) die("no length specified");
+
+        const auto length = vm.at("length").as<std::size_t>();
+        if (length >= std::numeric_limits<std::size_t>::max() / element_size)
+            die("length is representable but too big to meaningfully try");
+
+        return length;
+    }
+
+    // Parses START:END:FACTOR into geometrically spaced lengths (rounded to
+    // whole elements, with any repeats removed). END is included only if one
+    // of the lengths lands on it.
+    [[nodiscard]]
+    std::vector<std::size_t>
+    extract_length_sweep(const po::variables_map& vm,
+                         const std::size_t element_size)
+    {
+        if (!vm.count("length-sweep")) return {};
+        if (vm.count("length"))
+            die("give a length or a length sweep, not both");
+
+        const auto& arg = vm.at("length-sweep").as<std::string>();
+        std::size_t start {}, end {};
+        double factor {};
+
+        try {
+            std::size_t pos {}, len {};
+            start = std::stoull(arg, &len);
+            pos += len;
+            if (arg.at(pos++) != ':') throw std::invalid_argument{"no colon"};
+            end = std::stoull(arg.substr(pos), &len);
+            pos += len;
+            if (arg.at(pos++) != ':') throw std::invalid_argument{"no colon"};
+            factor = std::stod(arg.substr(pos), &len);
+            if (pos + len != arg.size())
+                throw std::invalid_argument{"trailing characters"};
+        }
+        catch (const std::logic_error&) {
+            die(fmt::format("length sweep \"{}\" is not START:END:FACTOR",
+                            arg));
+        }
+
+        if (start == 0u || start > end)
+            die("length sweep must grow from START");
+        if (!(factor > 1.0)) die("length sweep factor must be greater than 1");
+        if (end >= std::numeric_limits<std::size_t>::max() / element_size)
+            die("length is representable but too big to meaningfully try");
+
+        std::vector<std::size_t> lengths;
+        for (auto x = static_cast<double>(start);
+                x < static_cast<double>(end) + 0.5; x *= factor) {
+            const auto length = static_cast<std::size_t>(std::llround(x));
+            if (lengths.empty() || lengths.back() != length)
+                lengths.push_back(length);
+        }
+
+        return lengths;
+    }
+
+    [[nodiscard]]
+    ElementType extract_element_type(const po::variables_map& vm)
+    {
+        if (!vm.count("type")) return ElementTag<std::uint32_t>{};
+
+        const auto& name = vm.at("type").as<std::string>();
+        if (const auto type = find_alternative<ElementType>(name)) return *type;
+
+        die(fmt::format("unrecognized element type \"{}\"", name));
+    }
+
+    [[nodiscard]]
+    std::tuple<unsigned, std::string_view>
+    obtain_seed_info(const po::variables_map& vm)
+    {
+        if (vm.count("seed"))
+            return {vm.at("seed").as<unsigned>(), "provided by the user"};
+
+        return {std::random_device{}(), "generated by the system"};
+    }
+
+    [[nodiscard]]
+    Distribution extract_distribution(const po::variables_map& vm)
+    {
+        auto dist = Distribution{Uniform{}};
+
+        if (vm.count("distribution")) {
+            const auto& name = vm.at("distribution").as<std::string>();
+            if (const auto found = find_alternative<Distribution>(name))
+                dist = *found;
+            else die(fmt::format("unrecognized distribution \"{}\"", name));
+        }
+
+        // Applies an option to the distribution it's for, if it was passed.
+        const auto apply = [&](const char* const option, auto& field) {
+            using Field = std::remove_reference_t<decltype(field)>;
+            if (vm.count(option)) field = vm.at(option).as<Field>();
+        };
+
+        visit(MultiLambda{
+            [](auto&) noexcept { },
+            [&](NearlySorted& d) {
+                apply("swaps", d.swap_percent);
+                if (!(d.swap_percent >= 0.0 && d.swap_percent <= 100.0))
+                    die("the percent of elements to swap must be 0 to 100");
+            },
+            [&](FewUnique& d) {
+                apply("unique", d.count);
+                if (d.count == 0u) die("there must be at least one value");
+            },
+            [&](Zipf& d) {
+                apply("zipf-exponent", d.exponent);
+                if (!(d.exponent > 0.0 && std::isfinite(d.exponent)))
+                    die("the zipf exponent must be positive and finite");
+            }
+        }, dist);
+
+        // Reject parameters for distributions that won't use them.
+        const auto reject = [&](const char* const option, const auto tag) {
+            using Tag = std::decay_t<decltype(tag)>;
+            if (vm.count(option) && !std::holds_alternative<Tag>(dist)) {
+                die(fmt::format("--{} is only meaningful with --distribution"
+                                " {}", option, tag.name));
+            }
+        };
+
+        reject("swaps", NearlySorted{});
+        reject("unique", FewUnique{});
+        reject("zipf-exponent", Zipf{});
+
+        return dist;
+    }
+
+    [[nodiscard]]
+    SortAlgorithm extract_sort_algorithm(const po::variables_map& vm)
+    {
+        if (!vm.count("algorithm")) return StdSort{};
+
+        const auto& name = vm.at("algorithm").as<std::string>();
+        if (const auto algorithm = find_alternative<SortAlgorithm>(name))
+            return *algorithm;
+
+        die(fmt::format("unrecognized sort algorithm \"{}\"", name));
+    }
+
+    [[nodiscard]]
+    AllocMode extract_alloc_mode(const po::variables_map& vm)
+    {
+        if (!vm.count("alloc")) return DefaultAlloc{};
+
+        const auto& name = vm.at("alloc").as<std::string>();
+        const auto alloc = find_alternative<AllocMode>(name);
+        if (!alloc) die(fmt::format("unrecognized allocation \"{}\"", name));
+
+#ifndef PMB_HAVE_MMAP
+        if (!std::holds_alternative<DefaultAlloc>(*alloc)
+                && !std::holds_alternative<UninitAlloc>(*alloc))
+            die(fmt::format("allocation \"{}\" is unsupported here", name));
+#endif
+
+        return *alloc;
+    }
+
+    [[nodiscard]]
+    std::optional<Advice> extract_advice(const po::variables_map& vm)
+    {
+        if (!vm.count("madvise")) return std::nullopt;
+
+        const auto& name = vm.at("madvise").as<std::string>();
+        if (const auto advice = find_alternative<Advice>(name)) return advice;
+
+        die(fmt::format("unrecognized madvise hint \"{}\"", name));
+    }
+
+    [[nodiscard]]
+    std::tuple<std::optional<std::filesystem::path>,
+               std::optional<std::filesystem::path>>
+    extract_files(const po::variables_map& vm)
+    {
+        const auto path = [&vm](const char* const name)
+                -> std::optional<std::filesystem::path> {
+            if (!vm.count(name)) return std::nullopt;
+            return std::filesystem::path{vm.at(name).as<std::string>()};
+        };
+
+        auto input = path("input"), output = path("output");
+        if (!input && !output) return {};
+
+#ifndef PMB_HAVE_MMAP_FILES
+        die("mapping files is unsupported here");
+#endif
+        if (input && output)
+            die("give an input file or an output file, not both");
+
+        return {std::move(input), std::move(output)};
+    }
+
+    // Finds how many elements an input file holds.
+    [[nodiscard]]
+    std::size_t extract_input_length(const po::variables_map& vm,
+                                     const std::filesystem::path& path,
+                                     const std::size_t element_size)
+    {
+        if (vm.count("length") || vm.count("length-sweep"))
+            die("an input file sets the length, so don't give one");
+
+        std::error_code ec;
+        const auto bytes = std::filesystem::file_size(path, ec);
+        if (ec) {
+            die(fmt::format("can't find the size of {}: {}", path.string(),
+                            ec.message()));
+        }
+        if (bytes == 0u || bytes % element_size != 0u) {
+            die(fmt::format("{} isn't a whole number of {}-byte elements",
+                            path.string(), element_size));
+        }
+        if (bytes > std::numeric_limits<std::size_t>::max())
+            die(fmt::format("{} is too big to map", path.string()));
+
+        return static_cast<std::size_t>(bytes) / element_size;
+    }
+
+    [[nodiscard]]
+    std::optional<NumaMode> extract_numa_mode(const po::variables_map& vm)
+    {
+        if (!vm.count("numa")) return std::nullopt;
+
+        const auto& name = vm.at("numa").as<std::string>();
+        const auto placement = find_alternative<NumaMode>(name);
+        if (!placement)
+            die(fmt::format("unrecognized NUMA placement \"{}\"", name));
+
+#ifndef PMB_HAVE_NUMA
+        die("NUMA placement is unsupported here");
+#endif
+
+        return placement;
+    }
+
+    [[nodiscard]]
+    double extract_middle(const po::variables_map& vm)
+    {
+        if (!vm.count("middle")) return 0.5;
+
+        const auto middle = vm.at("middle").as<double>();
+        if (!(middle >= 0.0 && middle <= 1.0))
+            die("the middle must be a fraction from 0 to 1");
+
+        return middle;
+    }
+
+    // The most buckets samplesort makes. Each block it scatters keeps a count
+    // per bucket.
+    constexpr std::size_t max_buckets {std::size_t{1} << 14};
+
+    // How big samplesort makes buckets if there's no L2 cache to go by.
+    constexpr std::uint64_t default_bucket_bytes {std::uint64_t{1} << 20};
+
+    // Gets samplesort's bucket count or, if it's to be found from the
+    // length, about how big to make buckets: as big as the first CPU's L2.
+    [[nodiscard]]
+    std::tuple<std::size_t, std::uint64_t>
+    extract_buckets(const po::variables_map& vm,
+                    const SortAlgorithm& algorithm)
+    {
+        if (!std::holds_alternative<SampleSort>(algorithm)) {
+            if (vm.count("buckets")) die("--buckets needs --algorithm sample");
+            return {0u, 0u};
+        }
+
+        if (vm.count("buckets")) {
+            const auto buckets = vm.at("buckets").as<std::size_t>();
+            if (buckets < 2u || buckets > max_buckets) {
+                die(fmt::format("the bucket count must be from 2 to {}",
+                                max_buckets));
+            }
+            return {buckets, 0u};
+        }
+
+        const auto topo = topology::detect();
+        const auto l2 = std::find_if(cbegin(topo.caches), cend(topo.caches),
+                                     [](const topology::Cache& cache) {
+            return cache.level == 2u && cache.type != "Instruction";
+        });
+
+        return {0u, (l2 == cend(topo.caches) || l2->bytes == 0u
+                        ? default_bucket_bytes : l2->bytes)};
+    }
+
+    [[nodiscard]]
+    ParallelMode extract_dynamic_execution_policy(const po::variables_map& vm)
+    {
+        const auto got_seq = vm.count("seq");
         const auto got_par = vm.count("par");
         const auto got_par_unseq = vm.count("par-unseq");
+        const auto got_pmb_par = vm.count("pmb-par");
+
+        switch (got_seq + got_par + got_par_unseq + got_pmb_par) {
+        case 0u:
+            return par;
+
+        case 1u:
+            if (got_seq) return seq;
+            if (got_par) return par;
+            if (got_par_unseq) return par_unseq;
+            if (got_pmb_par) return pmb_par;
+            NOT_REACHED();
+
+        default:
+            die("at most one of (--seq, --par, --par-unseq, --pmb-par) is"
+                " accepted");
+        }
+    }
+
+    [[nodiscard]]
+    std::vector<unsigned> extract_thread_sweep(const po::variables_map& vm,
+                                               const ParallelMode& mode)
+    {
+        if (!vm.count("threads")) return {};
+
+        if (std::holds_alternative<sequenced_policy>(mode))
+            die("a thread sweep needs a parallel mode");
+
+#ifndef PMB_HAVE_TBB_CONTROL
+        if (!std::holds_alternative<pool_policy>(mode))
+            die("this build can't limit its parallel algorithms' threads");
+#endif
+
+        std::stringstream arg {vm.at("threads").as<std::string>()};
+        std::vector<unsigned> counts;
+
+        for (std::string item; std::getline(arg, item, ','); ) {
+            try {
+                std::size_t pos {};
+                const auto count = std::stoul(item, &pos);
+                if (pos != item.size() || count == 0u
+                        || count > std::numeric_limits<unsigned>::max())
+                    throw std::invalid_argument{"bad thread count"};
+                counts.push_back(static_cast<unsigned>(count));
+            }
+            catch (const std::logic_error&) {
+                die(fmt::format("\"{}\" is not a positive thread count",
+                                item));
+            }
+        }
+
+        return counts;
+    }
+
+    [[nodiscard]]
+    std::tuple<std::optional<PinMode>, std::vector<unsigned>>
+    extract_pinning(const po::variables_map& vm, const ParallelMode& mode)
+    {
+        if (!vm.count("pin")) return {};
+
+#ifndef PMB_HAVE_NUMA
+        die("pinning threads is unsupported here");
+#endif
+#ifndef PMB_HAVE_TBB_CONTROL
+        if (std::holds_alternative<parallel_policy>(mode)
+                || std::holds_alternative<parallel_unsequenced_policy>(mode))
+            die("this build can't pin its parallel algorithms' threads");
+#else
+        static_cast<void>(mode);
+#endif
+
+        const auto& arg = vm.at("pin").as<std::string>();
+        const auto topo = topology::detect();
+
+        if (const auto pin = find_alternative<PinMode>(arg)) {
+            if (topo.cpus.empty()) die("can't find this system's CPUs");
+
+            auto cpus = visit(MultiLambda{
+                [&](PinCompact) { return topology::compact_order(topo); },
+                [&](PinScatter) { return topology::scatter_order(topo); },
+                [](PinList) -> std::vector<unsigned> {
+                    die("give --pin a list of CPUs, like 0-3,8");
+                }
+            }, *pin);
+
+            return {*pin, std::move(cpus)};
+        }
+
+        std::vector<unsigned> cpus;
+        try {
+            for (auto p = cbegin(arg); p != cend(arg); ++p) {
+                if (!std::isdigit(static_cast<unsigned char>(*p))
+                        && *p != ',' && *p != '-')
+                    throw std::invalid_argument{"not a CPU list"};
+            }
+            cpus = topology::parse_cpu_list(arg);
+        }
+        catch (const std::logic_error&) {
+            die(fmt::format("\"{}\" is not compact, scatter, or a list of CPUs",
+                            arg));
+        }
+
+        if (cpus.empty()) die("give --pin at least one CPU");
+        return {PinList{}, std::move(cpus)};
+    }
+
+    [[nodiscard]]
+    std::vector<Kernel> extract_kernels(const po::variables_map& vm,
+                                        const ElementType& element_type)
+    {
+        if (!vm.count("kernel")) return {};
+
+        const auto numeric = visit([](auto tag) noexcept {
+            return std::is_arithmetic_v<typename decltype(tag)::type>;
+        }, element_type);
+        if (!numeric) die("the bandwidth kernels need a numeric --type");
+
+        const auto& arg = vm.at("kernel").as<std::string>();
+        if (arg == "all") {
+            return {CopyKernel{}, ScaleKernel{}, AddKernel{}, TriadKernel{},
+                    ReadKernel{}, WriteKernel{}};
+        }
+
+        std::stringstream items {arg};
+        std::vector<Kernel> kernels;
+
+        for (std::string item; std::getline(items, item, ','); ) {
+            if (const auto kernel = find_alternative<Kernel>(item))
+                kernels.push_back(*kernel);
+            else die(fmt::format("unrecognized kernel \"{}\"", item));
+        }
+
+        if (kernels.empty()) die("give --kernel at least one kernel");
+        return kernels;
+    }
+
+    [[nodiscard]]
+    std::optional<LatencyMode> extract_latency_mode(const po::variables_map& vm,
+                                                    const Parameters& params)
+    {
+        if (!vm.count("latency")) return std::nullopt;
+
+        const auto& name = vm.at("latency").as<std::string>();
+        const auto latency = find_alternative<LatencyMode>(name);
+        if (!latency)
+            die(fmt::format("unrecognized latency mode \"{}\"", name));
+
+        // The elements are the links, so they must be able to index the array.
+        const auto max_index = visit([](auto tag) -> std::uint64_t {
+            using T = typename decltype(tag)::type;
+
+            if constexpr (std::is_integral_v<T> && std::is_unsigned_v<T>)
+                return std::numeric_limits<T>::max();
+            else die("pointer chasing needs --type u32 or u64");
+        }, params.element_type);
+
+        if (params.length == 0u || params.length - 1u > max_index)
+            die("pointer chasing needs a length its elements can index");
+
+        return latency;
+    }
+
+    [[nodiscard]]
+    std::tuple<std::optional<std::filesystem::path>, std::size_t>
+    extract_external(const po::variables_map& vm, const Parameters& params)
+    {
+        if (!vm.count("external")) {
+            if (vm.count("run-length")) die("--run-length needs --external");
+            return {std::nullopt, 0u};
+        }
+
+        std::filesystem::path dir {vm.at("external").as<std::string>()};
+        std::error_code ec;
+        if (!std::filesystem::is_directory(dir, ec))
+            die(fmt::format("\"{}\" is not a directory", dir.string()));
+
+        if (!params.length_sweep.empty() || !params.kernels.empty()
+                || params.latency || params.input || params.output)
+            die("--external can't be combined with --length-sweep, --kernel,"
+                " --latency, --input, or --output");
+        if (uses_middle(params.algorithm))
+            die("an external sort needs an algorithm that sorts fully");
+        if (params.length == 0u)
+            die("an external sort needs at least one element");
+
+        const auto requested = (vm.count("run-length")
+                                    ? vm.at("run-length").as<std::size_t>()
+                                    : default_run_length);
+        if (requested == 0u) die("the run length must be positive");
+
+        // Runs start at generation blocks, so blockwise input is the same as
+        // it would be in memory.
+        const auto remainder = requested % generation_block_length;
+        const auto run_length = (remainder == 0u
+                                    ? requested
+                                    : requested - remainder
+                                        + generation_block_length);
+
+        return {std::move(dir), run_length};
+    }
+
+    // The fewest trials whose times, compared with as many from a baseline,
+    // can differ significantly (see --compare), and how many are run when
+    // saving or comparing with a baseline, unless --trials says otherwise.
+    constexpr int min_compared_trials {4};
+    constexpr int default_compared_trials {5};
+
+    [[nodiscard]]
+    std::tuple<int, int> extract_trial_counts(const po::variables_map& vm)
+    {
+        const auto compared = (vm.count("save-baseline") != 0u
+                                || vm.count("compare") != 0u);
+
+        const auto trials = (vm.count("trials") ? vm.at("trials").as<int>()
+                             : compared ? default_compared_trials
+                             : 1);
+        if (trials < 1) die("there must be at least one trial");
+        if (compared && trials < min_compared_trials) {
+            die(fmt::format("--save-baseline and --compare need at least {}"
+                            " trials, or no change could be significant",
+                            min_compared_trials));
+        }
+
+        const auto warmups = (vm.count("warmup") ? vm.at("warmup").as<int>()
+                                                 : 0);
+        if (warmups < 0) die("the number of warmups can't be negative");
+
+        return {trials, warmups};
+    }
+
+    [[nodiscard]]
+    std::tuple<int, double> extract_instances(const po::variables_map& vm,
+                                              const Parameters& params)
+    {
+        const auto instances = (vm.count("instances")
+                                    ? vm.at("instances").as<int>() : 1);
+        if (instances < 1) die("there must be at least one instance");
+
+        // Instances share the process, so what's made once per process can't
+        // be shared: files, sweeps, and the pool (which takes one caller).
+        if (instances > 1 && (params.external || params.input || params.output
+                              || !params.length_sweep.empty()
+                              || !params.thread_sweep.empty()
+                              || std::holds_alternative<pool_policy>(
+                                    params.mode))) {
+            die("--instances can't be combined with --external, --input,"
+                " --output, --length-sweep, --threads, or --pmb-par");
+        }
+
+        if (!vm.count("duration")) return {instances, 0.0};
+
+        if (!vm.count("instances")) die("--duration needs --instances");
+        if (vm.count("trials")) die("--duration replaces --trials");
+
+        const auto duration = vm.at("duration").as<double>();
+        if (!(duration > 0.0 && duration < 1e9))
+            die("the duration must be a positive number of seconds");
+
+        return {instances, duration};
+    }
+
+    [[nodiscard]]
+    double extract_soak(const po::variables_map& vm, const Parameters& params)
+    {
+        if (!vm.count("soak")) return 0.0;
+
+        const auto& arg = vm.at("soak").as<std::string>();
+        auto seconds = 0.0;
+
+        try {
+            std::size_t pos {};
+            const auto value = std::stod(arg, &pos);
+            const auto unit = std::string_view{arg}.substr(pos);
+
+            if (unit.empty() || unit == "s") seconds = value;
+            else if (unit == "m") seconds = value * 60.0;
+            else if (unit == "h") seconds = value * 3600.0;
+            else if (unit == "d") seconds = value * 86400.0;
+        }
+        catch (const std::logic_error&) {
+        }
+
+        if (!(seconds > 0.0 && seconds < 1e9)) {
+            die(fmt::format("\"{}\" is not a duration (like 90s, 30m, or 8h)",
+                            arg));
+        }
+
+        // A soak reuses one array, so it can't map files or sweep, and it
+        // keeps its own time, so it doesn't take trials or instances.
+        if (params.external || params.input || params.output
+                || !params.length_sweep.empty()
+                || !params.thread_sweep.empty() || params.instances > 1
+                || vm.count("trials") || vm.count("duration")) {
+            die("--soak can't be combined with --external, --input, --output,"
+                " --length-sweep, --threads, --trials, --instances, or"
+                " --duration");
+        }
+
+        // Blocks are compared whole, but a partial sort leaves the rest of
+        // the array in an unspecified order, which can differ between tests.
+        if (uses_middle(params.algorithm))
+            die("a soak needs an algorithm that sorts fully");
+
+        return seconds;
+    }
+
+    [[nodiscard]]
+    int extract_pipeline(const po::variables_map& vm, const Parameters& params)
+    {
+        if (!vm.count("pipeline")) return 0;
+
+        const auto buffers = vm.at("pipeline").as<int>();
+        if (buffers < 2 || buffers > 64)
+            die("a pipeline needs from 2 to 64 buffers");
+
+        // Stages of different trials run at once on their own buffers, so
+        // what works on one array, or takes the pool's one caller, can't.
+        if (params.external || params.input || params.output
+                || !params.length_sweep.empty() || !params.kernels.empty()
+                || params.latency || params.instances > 1 || params.soak > 0.0
+                || std::holds_alternative<pool_policy>(params.mode)) {
+            die("--pipeline can't be combined with --external, --input,"
+                " --output, --length-sweep, --kernel, --latency, --instances,"
+                " --soak, or --pmb-par");
+        }
+
+        return buffers;
+    }
+
+    [[nodiscard]]
+    std::tuple<std::optional<std::filesystem::path>, std::chrono::milliseconds>
+    extract_sampling(const po::variables_map& vm)
+    {
+        static constexpr auto default_interval = 100;
+
+        if (!vm.count("sample")) {
+            if (vm.count("sample-interval"))
+                die("--sample-interval needs --sample");
+            return {std::nullopt, std::chrono::milliseconds{default_interval}};
+        }
+
+        const auto interval = (vm.count("sample-interval")
+                                ? vm.at("sample-interval").as<int>()
+                                : default_interval);
+        if (interval < 1 || interval > 60000)
+            die("the sample interval must be from 1 to 60000 ms");
+
+        return {std::filesystem::path{vm.at("sample").as<std::string>()},
+                std::chrono::milliseconds{interval}};
+    }
+
+    [[nodiscard]]
+    std::tuple<std::optional<Perturbation>, std::vector<double>>
+    extract_perturbation(const po::variables_map& vm, const Parameters& params)
+    {
+        if (!vm.count("perturb")) {
+            if (vm.count("perturb-levels"))
+                die("--perturb-levels needs --perturb");
+            return {std::nullopt, {}};
+        }
+
+        const auto& name = vm.at("perturb").as<std::string>();
+        const auto how = find_alternative<Perturbation>(name);
+        if (!how) die(fmt::format("unrecognized perturbation \"{}\"", name));
+
+        // Perturbing sorts again, and the other modes don't keep one array.
+        if (params.inplace_reps > 1)
+            die("--perturb replaces --twice, so they can't be combined");
+        if (params.external || params.pipeline > 0)
+            die("--perturb can't be combined with --external or --pipeline");
+
+        if (!vm.count("perturb-levels")) return {how, {0.001, 0.01, 0.1}};
+
+        std::stringstream items {vm.at("perturb-levels").as<std::string>()};
+        std::vector<double> levels;
+
+        for (std::string item; std::getline(items, item, ','); ) {
+            double level {};
+
+            try {
+                std::size_t len {};
+                level = std::stod(item, &len);
+                if (len != item.size())
+                    throw std::invalid_argument{"trailing characters"};
+            }
+            catch (const std::logic_error&) {
+                die(fmt::format("perturbation level \"{}\" is not a number",
+                                item));
+            }
+
+            // A tail of more than half has too little sorted part to leave.
+            if (!(level > 0.0 && level <= 1.0))
+                die("perturbation levels must be in (0, 1]");
+            if (std::holds_alternative<PerturbTail>(*how) && level > 0.5)
+                die("tail perturbation levels must be at most 0.5");
+
+            levels.push_back(level);
+        }
+
+        if (levels.empty()) die("give --perturb-levels at least one level");
+        return {how, levels};
+    }
+
+    [[nodiscard]]
+    std::tuple<std::optional<std::filesystem::path>,
+               std::optional<std::filesystem::path>, double>
+    extract_baseline_files(const po::variables_map& vm)
+    {
+        std::optional<std::filesystem::path> save, compare;
+        if (vm.count("save-baseline"))
+            save = vm.at("save-baseline").as<std::string>();
+        if (vm.count("compare")) compare = vm.at("compare").as<std::string>();
+
+        if (!vm.count("threshold")) return {save, compare, 0.05};
+        if (!compare) die("--threshold needs --compare");
+
+        const auto percent = vm.at("threshold").as<double>();
+        if (!(percent >= 0.0 && percent < 1e6))
+            die("the threshold must be a nonnegative percentage");
+
+        return {save, compare, percent / 100.0};
+    }
+
+    [[nodiscard]]
+    OutputFormat extract_output_format(const po::variables_map& vm)
+    {
+        if (!vm.count("format")) return OutputFormat::text;
+
+        const auto& name = vm.at("format").as<std::string>();
+        if (name == "text") return OutputFormat::text;
+        if (name == "json") return OutputFormat::json;
+        if (name == "csv") return OutputFormat::csv;
+
+        die(fmt::format("unrecognized output format \"{}\"", name));
+    }
+
+    [[nodiscard]]
+    Parameters extract_operating_parameters(const po::variables_map& vm)
+    {
+        Parameters params {};
+
+        params.element_type = extract_element_type(vm);
+        std::tie(params.input, params.output) = extract_files(vm);
+        if (params.input) {
+            params.length = extract_input_length(
+                                vm, *params.input,
+                                element_size(params.element_type));
+        }
+        else {
+            params.length_sweep = extract_length_sweep(
+                                    vm, element_size(params.element_type));
+            params.length = (params.length_sweep.empty()
+                                ? extract_length(
+                                    vm, element_size(params.element_type))
+                                : params.length_sweep.back());
+        }
+        std::tie(params.seed, params.seed_origin) = obtain_seed_info(vm);
+        params.distribution = extract_distribution(vm);
+        params.algorithm = extract_sort_algorithm(vm);
+        params.middle = extract_middle(vm);
+        std::tie(params.buckets, params.bucket_bytes) = extract_buckets(
+                vm, params.algorithm);
+        params.mode = extract_dynamic_execution_policy(vm);
+        params.alloc = extract_alloc_mode(vm);
+        params.numa = extract_numa_mode(vm);
+        if (params.numa) {
+            if (!vm.count("alloc")) params.alloc = MmapAlloc{};
+            else if (std::holds_alternative<DefaultAlloc>(params.alloc)
+                        || std::holds_alternative<UninitAlloc>(params.alloc))
+                die("NUMA placement needs a mapped allocation");
+        }
+        if (params.input || params.output) {
+            if (!vm.count("alloc")) params.alloc = MmapAlloc{};
+            else if (!std::holds_alternative<MmapAlloc>(params.alloc)
+                        && !std::holds_alternative<PrefaultAlloc>(params.alloc))
+                die("a mapped file needs --alloc mmap or prefault");
+            if (params.numa)
+                die("NUMA placement isn't supported for a mapped file");
+            if (!params.length_sweep.empty())
+                die("a mapped file can't be used with a length sweep");
+        }
+        params.advice = extract_advice(vm);
+        if (params.advice && (std::holds_alternative<DefaultAlloc>(params.alloc)
+                || std::holds_alternative<UninitAlloc>(params.alloc)))
+            die("--madvise needs a mapped allocation");
+        params.thread_sweep = extract_thread_sweep(vm, params.mode);
+        std::tie(params.pin, params.pin_cpus) = extract_pinning(vm,
+                                                                params.mode);
+        if (!params.length_sweep.empty() && !params.thread_sweep.empty())
+            die("sweeping both lengths and threads is not supported");
+        params.blockwise_generation = vm.count("blocks");
+        params.inplace_reps = (vm.count("twice") ? 2 : 1);
+        std::tie(params.trials, params.warmups) = extract_trial_counts(vm);
+        params.format = extract_output_format(vm);
+        std::tie(params.save_baseline, params.compare, params.threshold) =
+                extract_baseline_files(vm);
+        std::tie(params.sample, params.sample_interval) = extract_sampling(vm);
+        params.show_start_time = vm.count("time");
+        params.counters = vm.count("counters");
+        params.kernels = extract_kernels(vm, params.element_type);
+        params.latency = extract_latency_mode(vm, params);
+        std::tie(params.external, params.run_length) = extract_external(vm,
+                                                                        params);
+        std::tie(params.instances, params.duration) = extract_instances(
+                vm, params);
+        params.soak = extract_soak(vm, params);
+        params.pipeline = extract_pipeline(vm, params);
+        std::tie(params.perturbation, params.perturb_levels) =
+                extract_perturbation(vm, params);
+
+        return params;
+    }
+
+    [[nodiscard]]
+    Parameters
+    configure(const int argc, const gsl::not_null<const char* const*> argv)
+    {
+        // Set the program name for error messages to the Unix-style basename.
+        assert(argc > 0);
+        program_name = std::filesystem::path{*argv}.filename().string();
+
+        // Fetch operating parameters from command-line arguments and defaults.
+        const auto params = extract_operating_parameters(
+                                parse_cmdline_args(argc, argv));
+
+        // A build may leave out kernels, and a thread sweep also sorts in seq.
+        const auto check_kernel = [&params](const ParallelMode& mode) {
+            if (sort_kernel_built(params.element_type, params.algorithm, mode))
+                return;
+
+            die(fmt::format("this build has no kernel to sort {} with {} in"
+                            " {} (see --list-kernels)",
+                            element_name(params.element_type),
+                            algorithm_name(params.algorithm),
+                            option_name(mode)));
+        };
+        check_kernel(params.mode);
+        if (!params.thread_sweep.empty()) check_kernel(seq);
+
+        // Keep stdout clean for machine-readable results, if we'll write them.
+        if (params.format != OutputFormat::text) {
+            default_console = stderr;
+            console = default_console;
+        }
+
+        return params;
+    }
+
+    // How much has been allocated through operator new, which the global
+    // replacements below count, so stages' temporary buffers can be measured.
+    namespace heap {
+        std::atomic<std::uint64_t> allocated {0u};
+        std::atomic<std::uint64_t> allocations {0u};
+        std::atomic<std::uint64_t> live {0u};
+        std::atomic<std::uint64_t> peak {0u};
+
+        void add(const std::size_t size) noexcept
+        {
+            allocated += size;
+            ++allocations;
+
+            const auto now = (live += size);
+            auto old = peak.load();
+            while (old < now && !peak.compare_exchange_weak(old, now)) { }
+        }
+
+        void remove(const std::size_t size) noexcept
+        {
+            live -= size;
+        }
+
+        // Makes the peak start over from the amount now live.
+        void reset_peak() noexcept
+        {
+            peak = live.load();
+        }
+
+        // Whether this thread's allocations are left out of the counts, as
+        // the sampler's are, so watching a run doesn't change what it shows.
+        thread_local bool uncounted = false;
+
+        // Whether stages may allocate where these counts can't see, as the
+        // TBB backend's parallel algorithms do (through TBB's allocator), so
+        // their counts are left out rather than shown too small.
+        bool hidden = false;
+
+        // Leaves this thread's allocations out of the counts while it exists.
+        class Uncounted {
+        public:
+            Uncounted() noexcept : was_{std::exchange(uncounted, true)} { }
+
+            Uncounted(const Uncounted&) = delete;
+            Uncounted& operator=(const Uncounted&) = delete;
+
+            ~Uncounted() { uncounted = was_; }
+
+        private:
+            bool was_;
+        };
+
+        // Room before each allocation to remember its size, keeping alignment.
+        constexpr auto header = alignof(std::max_align_t);
+        static_assert(header >= sizeof(std::size_t));
+
+        // Marks a remembered size as not counted, so freeing it (on any
+        // thread) isn't counted either.
+        constexpr auto uncounted_size = (std::size_t{1}
+                                         << (sizeof(std::size_t) * CHAR_BIT
+                                             - 1u));
+    }
+
+    // An in-tree fork-join scheduler, so --pmb-par runs the same way on every
+    // platform, whatever backend the standard library's algorithms use. Each
+    // worker has a deque of the tasks it forked. Its owner pushes and pops at
+    // the bottom, and idle workers steal from the top, without locks (Chase
+    // and Lev's deque, with the memory orders of Le et al., PPoPP 2013). The
+    // thread that calls into the pool from outside borrows slot 0.
+    namespace pool {
+        // Tasks forked, and tasks stolen, by pools that have been destroyed.
+        std::atomic<std::uint64_t> retired_forked {0u};
+        std::atomic<std::uint64_t> retired_stolen {0u};
+
+        // Tasks forked, and tasks stolen, by one worker. Only that worker
+        // writes them, and they have a cache line to themselves, so counting
+        // doesn't add contention to the stealing it measures.
+        struct alignas(64) Tally {
+            std::atomic<std::uint64_t> forked {0u};
+            std::atomic<std::uint64_t> stolen {0u};
+
+            static void add(std::atomic<std::uint64_t>& count) noexcept
+            {
+                count.store(count.load(std::memory_order_relaxed) + 1u,
+                            std::memory_order_relaxed);
+            }
+        };
+
+        // A forked call, which records when it has run.
+        struct Task {
+            void (*call)(const void*);
+            const void* context;
+            std::atomic<bool> done {false};
+
+            void run() noexcept
+            {
+                call(context);
+                done.store(true, std::memory_order_release);
+            }
+        };
+
+        // A bounded work-stealing deque of tasks.
+        class Deque {
+        public:
+            // Pushes a task at the bottom. Only the owner may call this.
+            // Returns false if the deque is full.
+            bool push(Task* const task) noexcept
+            {
+                const auto b = bottom_.load(std::memory_order_relaxed);
+                const auto t = top_.load(std::memory_order_acquire);
+                if (b - t >= capacity) return false;
+
+                slots_[index(b)].store(task, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+                bottom_.store(b + 1, std::memory_order_relaxed);
+                return true;
+            }
+
+            // Pops the bottom task, if any. Only the owner may call this.
+            Task* pop() noexcept
+            {
+                const auto b = bottom_.load(std::memory_order_relaxed) - 1;
+                bottom_.store(b, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                auto t = top_.load(std::memory_order_relaxed);
+
+                if (t > b) {
+                    bottom_.store(b + 1, std::memory_order_relaxed);
+                    return nullptr;
+                }
+
+                auto task = slots_[index(b)].load(std::memory_order_relaxed);
+                if (t == b) {
+                    // This is the last task, so race thieves for it.
+                    if (!top_.compare_exchange_strong(
+                            t, t + 1, std::memory_order_seq_cst,
+                            std::memory_order_relaxed))
+                        task = nullptr;
+                    bottom_.store(b + 1, std::memory_order_relaxed);
+                }
+                return task;
+            }
+
+            // Steals the top task, if any, and if no one else gets it first.
+            Task* steal() noexcept
+            {
+                auto t = top_.load(std::memory_order_acquire);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                const auto b = bottom_.load(std::memory_order_acquire);
+                if (t >= b) return nullptr;
+
+                const auto task = slots_[index(t)].load(
+                                    std::memory_order_relaxed);
+                if (!top_.compare_exchange_strong(t, t + 1,
+                                                  std::memory_order_seq_cst,
+                                                  std::memory_order_relaxed))
+                    return nullptr;
+                return task;
+            }
+
+        private:
+            // Forks nest only as deep as the recursion, so this is plenty.
+            static constexpr std::int64_t capacity {1024};
+
+            [[nodiscard]]
+            static std::size_t index(const std::int64_t i) noexcept
+            {
+                return static_cast<std::size_t>(i % capacity);
+            }
+
+            alignas(64) std::atomic<std::int64_t> top_ {0};
+            alignas(64) std::atomic<std::int64_t> bottom_ {0};
+            alignas(64) std::array<std::atomic<Task*>, capacity> slots_ {};
+        };
+
+        class Pool {
+        public:
+            // Starts a pool of some number of threads (counting the one that
+            // calls into it), which becomes the current pool. If there are
+            // CPUs, the thread in slot i runs on cpus[i % size].
+            Pool(const unsigned threads, std::vector<unsigned> cpus)
+                : deques_(std::max(threads, 1u)), tallies_(deques_.size()),
+                  cpus_{std::move(cpus)}
+            {
+                assert(!current_);
+
+                for (auto slot = 1u; slot < deques_.size(); ++slot)
+                    workers_.emplace_back([this, slot] { work(slot); });
+
+                current_ = this;
+            }
+
+            Pool(const Pool&) = delete;
+            Pool& operator=(const Pool&) = delete;
+
+            ~Pool()
+            {
+                {
+                    const std::lock_guard lock {mutex_};
+                    stop_ = true;
+                }
+                wake_.notify_all();
+
+                for (auto& worker : workers_) worker.join();
+                current_ = nullptr;
+
+                const auto [forked, stolen] = counts();
+                retired_forked += forked;
+                retired_stolen += stolen;
+            }
+
+            // The pool in use, if any.
+            [[nodiscard]]
+            static Pool* current() noexcept { return current_; }
+
+            // How many threads run tasks, counting the one that calls in.
+            [[nodiscard]]
+            std::size_t size() const noexcept { return deques_.size(); }
+
+            // Tasks this pool's workers have forked, and stolen.
+            [[nodiscard]]
+            std::pair<std::uint64_t, std::uint64_t> counts() const noexcept
+            {
+                std::pair<std::uint64_t, std::uint64_t> sums {};
+                for (const auto& tally : tallies_) {
+                    sums.first += tally.forked.load(std::memory_order_relaxed);
+                    sums.second += tally.stolen.load(std::memory_order_relaxed);
+                }
+                return sums;
+            }
+
+            // Calls f and g, maybe in parallel, returning when both are done.
+            // While g is stolen, this thread runs other tasks.
+            template<typename F, typename G>
+            void invoke(const F& f, const G& g)
+            {
+                if (slot_ == outside) {
+                    const Entry entry {*this};
+                    invoke(f, g);
+                    return;
+                }
+
+                const auto call = [](const void* const context) {
+                    (*static_cast<const G*>(context))();
+                };
+
+                Task task {call, &g};
+                auto& deque = deques_[slot_];
+
+                if (!deque.push(&task)) {
+                    f();
+                    g();
+                    return;
+                }
+
+                Tally::add(tallies_[slot_].forked);
+                f();
+
+                // If g wasn't stolen, it's still on the bottom.
+                if (deque.pop() == &task) {
+                    g();
+                    return;
+                }
+
+                while (!task.done.load(std::memory_order_acquire)) {
+                    if (!run_stolen()) std::this_thread::yield();
+                }
+            }
+
+        private:
+            static constexpr auto outside = std::numeric_limits<
+                                                std::size_t>::max();
+
+            // Lends slot 0 to a thread calling in from outside, and keeps the
+            // workers looking for tasks while it's in.
+            class Entry {
+            public:
+                explicit Entry(Pool& pool) : pool_{pool}
+                {
+                    slot_ = 0u;
+                    {
+                        const std::lock_guard lock {pool_.mutex_};
+                        pool_.busy_.store(true, std::memory_order_relaxed);
+                    }
+                    pool_.wake_.notify_all();
+                }
+
+                Entry(const Entry&) = delete;
+                Entry& operator=(const Entry&) = delete;
+
+                ~Entry()
+                {
+                    pool_.busy_.store(false, std::memory_order_relaxed);
+                    slot_ = outside;
+                }
+
+            private:
+                Pool& pool_;
+            };
+
+            // Steals a task from another slot and runs it, if there is one.
+            bool run_stolen()
+            {
+                const auto n = deques_.size();
+
+                for (std::size_t k = 1u; k < n; ++k) {
+                    if (const auto task = deques_[(slot_ + k) % n].steal()) {
+                        Tally::add(tallies_[slot_].stolen);
+                        task->run();
+                        return true;
+                    }
+                }
+
+                return false;
+            }
+
+            // Runs a worker thread: waits until a thread calls in, then steals
+            // tasks until it leaves.
+            void work(const std::size_t slot)
+            {
+                slot_ = slot;
+#ifdef PMB_HAVE_NUMA
+                if (!cpus_.empty())
+                    topology::pin_current_thread({cpus_[slot % cpus_.size()]});
+#else
+                static_cast<void>(cpus_);
+#endif
+
+                for (; ; ) {
+                    {
+                        std::unique_lock lock {mutex_};
+                        wake_.wait(lock, [this] {
+                            return stop_ || busy_.load();
+                        });
+                        if (stop_) return;
+                    }
+
+                    while (busy_.load(std::memory_order_relaxed)) {
+                        if (!run_stolen()) std::this_thread::yield();
+                    }
+                }
+            }
+
+            inline static Pool* current_ {nullptr};
+            inline static thread_local std::size_t slot_ {outside};
+
+            std::vector<Deque> deques_;
+            std::vector<Tally> tallies_; // for each slot, like deques_
+            std::vector<unsigned> cpus_;
+            std::vector<std::thread> workers_;
+            std::mutex mutex_;
+            std::condition_variable wake_;
+            std::atomic<bool> busy_ {false};
+            bool stop_ {false};
+        };
+
+        // Calls f and g, in parallel on the current pool, if any.
+        template<typename F, typename G>
+        void invoke(const F& f, const G& g)
+        {
+            if (const auto pool = Pool::current()) {
+                pool->invoke(f, g);
+            }
+            else {
+                f();
+                g();
+            }
+        }
+
+        // Tasks forked, and tasks stolen, by all workers of all pools so far.
+        [[nodiscard]]
+        std::pair<std::uint64_t, std::uint64_t> counts() noexcept
+        {
+            auto sums = std::pair{retired_forked.load(), retired_stolen.load()};
+            if (const auto pool = Pool::current()) {
+                const auto [forked, stolen] = pool->counts();
+                sums.first += forked;
+                sums.second += stolen;
+            }
+            return sums;
+        }
+
+        // Finds how many indices a leaf task should get, so each thread has
+        // several tasks to balance with.
+        [[nodiscard]]
+        std::size_t grain(const std::size_t count) noexcept
+        {
+            const auto pool = Pool::current();
+            const auto tasks = (pool ? pool->size() * 8u : 1u);
+            return std::max(count / tasks, std::size_t{1});
+        }
+
+        // Calls func(first, last) on subranges of [first, last) no longer
+        // than grain, splitting in halves in parallel.
+        template<typename Func>
+        void for_each_range(const std::size_t first, const std::size_t last,
+                            const std::size_t grain, const Func& func)
+        {
+            if (last - first <= grain) {
+                func(first, last);
+                return;
+            }
+
+            const auto mid = first + (last - first) / 2u;
+            invoke([&] { for_each_range(first, mid, grain, func); },
+                   [&] { for_each_range(mid, last, grain, func); });
+        }
+
+        // Reduces func(first, last) on subranges of [first, last), which
+        // must be nonempty, like for_each_range.
+        template<typename T, typename Reduce, typename Func>
+        [[nodiscard]]
+        T reduce_range(const std::size_t first, const std::size_t last,
+                       const std::size_t grain, const Reduce& reduce,
+                       const Func& func)
+        {
+            if (last - first <= grain) return func(first, last);
+
+            const auto mid = first + (last - first) / 2u;
+            std::optional<T> left, right;
+            invoke([&] { left = reduce_range<T>(first, mid, grain,
+                                                reduce, func); },
+                   [&] { right = reduce_range<T>(mid, last, grain,
+                                                 reduce, func); });
+            return reduce(std::move(*left), std::move(*right));
+        }
+
+        // Below this, sorts don't fork.
+        constexpr std::ptrdiff_t sort_cutoff {std::ptrdiff_t{1} << 14};
+
+        // From this length, sorts partition in parallel blocks of this many
+        // elements, into a scratch buffer.
+        constexpr std::ptrdiff_t partition_block {sort_cutoff};
+        constexpr std::ptrdiff_t parallel_partition_min {partition_block * 8};
+
+        // Calls func(i, j) on subranges of [0, length), in parallel.
+        template<typename Func>
+        void for_each_part(const std::ptrdiff_t length, const Func& func)
+        {
+            const auto count = static_cast<std::size_t>(length);
+            for_each_range(0u, count, grain(count),
+                           [&](const std::size_t i, const std::size_t j) {
+                func(static_cast<std::ptrdiff_t>(i),
+                     static_cast<std::ptrdiff_t>(j));
+            });
+        }
+
+        // Copies [first, first + length) to out, in parallel.
+        template<typename In, typename Out>
+        void copy(const In first, const std::ptrdiff_t length, const Out out)
+        {
+            for_each_part(length, [&](const std::ptrdiff_t i,
+                                      const std::ptrdiff_t j) {
+                std::copy(first + i, first + j, out + i);
+            });
+        }
+
+        // Partitions [first, last) three ways around pivot in a single pass
+        // (like the Dutch national flag), returning the equal part's bounds.
+        template<typename It, typename T>
+        [[nodiscard]]
+        std::pair<It, It> partition3(It first, It last, const T& pivot)
+        {
+            for (auto i = first; i != last; ) {
+                if (*i < pivot)
+                    std::iter_swap(first++, i++);
+                else if (pivot < *i)
+                    std::iter_swap(i, --last);
+                else
+                    ++i;
+            }
+            return {first, last};
+        }
+
+        // Partitions src[0, length) three ways around pivot into dst[0,
+        // length), in parallel blocks: each block counts its elements less
+        // than and equal to the pivot, then places them where the counts
+        // before it say. Returns the lengths of the less and equal parts.
+        template<typename In, typename Out, typename T>
+        [[nodiscard]]
+        std::pair<std::ptrdiff_t, std::ptrdiff_t>
+        partition3_copy(const In src, const Out dst,
+                        const std::ptrdiff_t length, const T& pivot)
+        {
+            const auto blocks = static_cast<std::size_t>(
+                    (length + partition_block - 1) / partition_block);
+            const auto bounds = [length](const std::size_t block) {
+                const auto i = static_cast<std::ptrdiff_t>(block)
+                                * partition_block;
+                return std::pair{i, std::min(i + partition_block, length)};
+            };
+            const auto part_of = [&pivot](const T& x) {
+                return (x < pivot ? 0u : pivot < x ? 2u : 1u);
+            };
+
+            // Each block's counts of less, equal, and greater elements, then
+            // where its elements of each part go.
+            std::vector<std::array<std::ptrdiff_t, 3>> places (blocks);
+
+            for_each_range(0u, blocks, 1u, [&](const std::size_t block,
+                                               std::size_t) {
+                const auto [i, j] = bounds(block);
+                auto& counts = places[block];
+                for (auto k = i; k != j; ++k) ++counts[part_of(src[k])];
+            });
+
+            std::array<std::ptrdiff_t, 3> next {};
+            for (const auto& counts : places) {
+                next[1] += counts[0];
+                next[2] += counts[0] + counts[1];
+            }
+            const auto less = next[1], equal = next[2] - next[1];
+
+            for (auto& counts : places) {
+                for (std::size_t part = 0u; part != 3u; ++part)
+                    next[part] += std::exchange(counts[part], next[part]);
+            }
+
+            for_each_range(0u, blocks, 1u, [&](const std::size_t block,
+                                               std::size_t) {
+                const auto [i, j] = bounds(block);
+                auto at = places[block];
+                for (auto k = i; k != j; ++k)
+                    dst[at[part_of(src[k])]++] = src[k];
+            });
+
+            return {less, equal};
+        }
+
+        // Sorts src[0, length) with introsort, leaving the result in src if
+        // it's home, or else in dst[0, length), which is. Partitions three
+        // ways around a median of three, then sorts the sides in parallel.
+        // Long parts are partitioned in parallel into the other buffer, so
+        // the sides move there, and the equal part goes home. Past a depth
+        // limit, or when short, a part is sorted sequentially.
+        template<typename Src, typename Dst>
+        void sort(const Src src, const Dst dst, const std::ptrdiff_t length,
+                  const int depth, const bool home)
+        {
+            if (length <= sort_cutoff || depth == 0) {
+                std::sort(src, src + length);
+                if (!home) std::copy(src, src + length, dst);
+                return;
+            }
+
+            const auto a = src[0], b = src[length / 2], c = src[length - 1];
+            const auto pivot = std::max(std::min(a, b),
+                                        std::min(std::max(a, b), c));
+
+            if (length < parallel_partition_min) {
+                const auto [lo, hi] = partition3(src, src + length, pivot);
+                const auto less = lo - src, greater = hi - src;
+                if (!home) std::copy(lo, hi, dst + less);
+
+                invoke([&] { pool::sort(src, dst, less, depth - 1, home); },
+                       [&] { pool::sort(src + greater, dst + greater,
+                                        length - greater, depth - 1,
+                                        home); });
+            }
+            else {
+                const auto parts = partition3_copy(src, dst, length, pivot);
+                const auto less = parts.first, greater = less + parts.second;
+                if (home) pool::copy(dst + less, parts.second, src + less);
+
+                invoke([&] { pool::sort(dst, src, less, depth - 1, !home); },
+                       [&] { pool::sort(dst + greater, src + greater,
+                                        length - greater, depth - 1,
+                                        !home); });
+            }
+        }
+
+        template<typename It>
+        void sort(const It first, const It last)
+        {
+            const auto length = last - first;
+            auto depth = 0;
+            for (auto n = length; n > 1; n /= 2) depth += 2;
+
+            if (length < parallel_partition_min) {
+                pool::sort(first, first, length, depth, true);
+                return;
+            }
+
+            using T = typename std::iterator_traits<It>::value_type;
+            const auto scratch = std::unique_ptr<T[]>(
+                    new T[static_cast<std::size_t>(length)]);
+            pool::sort(first, scratch.get(), length, depth, true);
+        }
+
+        // Merges sorted [first1, first1 + length1) and [first2, first2 +
+        // length2) into out, stably, in parallel. Each part of the output
+        // finds by co-ranking how many elements before its start and end
+        // come from each input, then merges its share sequentially.
+        template<typename In, typename Out>
+        void merge(const In first1, const std::ptrdiff_t length1,
+                   const In first2, const std::ptrdiff_t length2,
+                   const Out out)
+        {
+            // How many of the first k merged elements come from first1.
+            const auto co_rank = [&](const std::ptrdiff_t k) {
+                auto lo = std::max(k - length2, std::ptrdiff_t{0});
+                auto hi = std::min(k, length1);
+                while (lo < hi) {
+                    const auto i = lo + (hi - lo) / 2;
+                    if (first2[k - i - 1] < first1[i])
+                        hi = i;
+                    else
+                        lo = i + 1;
+                }
+                return lo;
+            };
+
+            for_each_part(length1 + length2, [&](const std::ptrdiff_t i,
+                                                 const std::ptrdiff_t j) {
+                const auto i1 = co_rank(i), j1 = co_rank(j);
+                std::merge(first1 + i1, first1 + j1,
+                           first2 + (i - i1), first2 + (j - j1), out + i);
+            });
+        }
+
+        // Sorts stably: sorts the halves in parallel, then merges them in
+        // parallel into scratch, which is as long, and copies them back.
+        template<typename It, typename Buf>
+        void stable_sort(const It first, const std::ptrdiff_t length,
+                         const Buf scratch)
+        {
+            if (length <= sort_cutoff) {
+                std::stable_sort(first, first + length);
+                return;
+            }
+
+            const auto half = length / 2;
+            invoke([&] { pool::stable_sort(first, half, scratch); },
+                   [&] { pool::stable_sort(first + half, length - half,
+                                           scratch + half); });
+            pool::merge(first, half, first + half, length - half, scratch);
+            pool::copy(scratch, length, first);
+        }
+
+        template<typename It>
+        void stable_sort(const It first, const It last)
+        {
+            const auto length = last - first;
+            if (length <= sort_cutoff) {
+                std::stable_sort(first, last);
+                return;
+            }
+
+            using T = typename std::iterator_traits<It>::value_type;
+            const auto scratch = std::unique_ptr<T[]>(
+                    new T[static_cast<std::size_t>(length)]);
+            pool::stable_sort(first, length, scratch.get());
+        }
+    }
+
+    // The parallel algorithms this program uses, taking a standard execution
+    // policy, or pmb_par to run them on the pool. Not every algorithm has a
+    // parallel version on the pool: partial_sort, nth_element, and
+    // inplace_merge run sequentially.
+    namespace algo {
+        template<typename Policy>
+        constexpr auto pooled = std::is_same_v<Policy, pool_policy>;
+
+        // Runs func(first + i, first + j) on slices of [first, last).
+        template<typename It, typename Func>
+        void for_each_slice(const It first, const It last, const Func& func)
+        {
+            const auto count = static_cast<std::size_t>(last - first);
+            const auto at = [first](const std::size_t i) {
+                return first + gsl::narrow_cast<std::ptrdiff_t>(i);
+            };
+
+            pool::for_each_range(0u, count, pool::grain(count),
+                                 [&](const std::size_t i, const std::size_t j) {
+                func(at(i), at(j));
+            });
+        }
+
+        template<typename Policy, typename It, typename Func>
+        void for_each(const Policy& policy, const It first, const It last,
+                      const Func& func)
+        {
+            if constexpr (pooled<Policy>) {
+                for_each_slice(first, last, [&](const It i, const It j) {
+                    std::for_each(i, j, func);
+                });
+            }
+            else {
+                std::for_each(policy, first, last, func);
+            }
+        }
+
+        template<typename Policy, typename It, typename T, typename Reduce,
+                 typename Func>
+        [[nodiscard]]
+        T transform_reduce(const Policy& policy, const It first, const It last,
+                           T init, const Reduce& reduce, const Func& func)
+        {
+            if constexpr (pooled<Policy>) {
+                const auto count = static_cast<std::size_t>(last - first);
+                if (count == 0u) return init;
+
+                const auto at = [first](const std::size_t i) {
+                    return first + gsl::narrow_cast<std::ptrdiff_t>(i);
+                };
+
+                return reduce(std::move(init), pool::reduce_range<T>(
+                        0u, count, pool::grain(count), reduce,
+                        [&](const std::size_t i, const std::size_t j) {
+                    T acc = func(*at(i));
+                    for (auto k = i + 1u; k != j; ++k)
+                        acc = reduce(std::move(acc), func(*at(k)));
+                    return acc;
+                }));
+            }
+            else {
+                return std::transform_reduce(policy, first, last,
+                                             std::move(init), reduce, func);
+            }
+        }
+
+        template<typename Policy, typename It>
+        [[nodiscard]]
+        auto reduce(const Policy& policy, const It first, const It last)
+        {
+            using T = typename std::iterator_traits<It>::value_type;
+            return algo::transform_reduce(policy, first, last, T{},
+                                          std::plus<>{},
+                                          [](const T& x) { return x; });
+        }
+
+        template<typename Policy, typename It, typename Pred>
+        [[nodiscard]]
+        bool none_of(const Policy& policy, const It first, const It last,
+                     const Pred& pred)
+        {
+            if constexpr (pooled<Policy>) {
+                return !algo::transform_reduce(policy, first, last, false,
+                                               std::logical_or<>{},
+                                               [&](const auto& x) {
+                    return static_cast<bool>(pred(x));
+                });
+            }
+            else {
+                return std::none_of(policy, first, last, pred);
+            }
+        }
+
+        template<typename Policy, typename In, typename Out>
+        void copy(const Policy& policy, const In first, const In last,
+                  const Out out)
+        {
+            if constexpr (pooled<Policy>) {
+                for_each_slice(first, last, [&](const In i, const In j) {
+                    std::copy(i, j, out + (i - first));
+                });
+            }
+            else {
+                std::copy(policy, first, last, out);
+            }
+        }
+
+        template<typename Policy, typename In, typename Out, typename Func>
+        void transform(const Policy& policy, const In first, const In last,
+                       const Out out, const Func& func)
+        {
+            if constexpr (pooled<Policy>) {
+                for_each_slice(first, last, [&](const In i, const In j) {
+                    std::transform(i, j, out + (i - first), func);
+                });
+            }
+            else {
+                std::transform(policy, first, last, out, func);
+            }
+        }
+
+        template<typename Policy, typename In1, typename In2, typename Out,
+                 typename Func>
+        void transform(const Policy& policy, const In1 first1, const In1 last1,
+                       const In2 first2, const Out out, const Func& func)
+        {
+            if constexpr (pooled<Policy>) {
+                for_each_slice(first1, last1, [&](const In1 i, const In1 j) {
+                    const auto offset = i - first1;
+                    std::transform(i, j, first2 + offset, out + offset, func);
+                });
+            }
+            else {
+                std::transform(policy, first1, last1, first2, out, func);
+            }
+        }
+
+        template<typename Policy, typename It, typename T>
+        void fill(const Policy& policy, const It first, const It last,
+                  const T& value)
+        {
+            if constexpr (pooled<Policy>) {
+                for_each_slice(first, last, [&](const It i, const It j) {
+                    std::fill(i, j, value);
+                });
+            }
+            else {
+                std::fill(policy, first, last, value);
+            }
+        }
+
+        template<typename Policy, typename It>
+        void sort(const Policy& policy, const It first, const It last)
+        {
+            if constexpr (pooled<Policy>)
+                pool::sort(first, last);
+            else
+                std::sort(policy, first, last);
+        }
+
+        template<typename Policy, typename It>
+        void stable_sort(const Policy& policy, const It first, const It last)
+        {
+            if constexpr (pooled<Policy>)
+                pool::stable_sort(first, last);
+            else
+                std::stable_sort(policy, first, last);
+        }
+
+        template<typename Policy, typename It>
+        void partial_sort(const Policy& policy, const It first,
+                          const It middle, const It last)
+        {
+            if constexpr (pooled<Policy>)
+                std::partial_sort(first, middle, last);
+            else
+                std::partial_sort(policy, first, middle, last);
+        }
+
+        template<typename Policy, typename It>
+        void nth_element(const Policy& policy, const It first,
+                         const It middle, const It last)
+        {
+            if constexpr (pooled<Policy>)
+                std::nth_element(first, middle, last);
+            else
+                std::nth_element(policy, first, middle, last);
+        }
+
+        template<typename Policy, typename It>
+        void inplace_merge(const Policy& policy, const It first,
+                           const It middle, const It last)
+        {
+            if constexpr (pooled<Policy>)
+                std::inplace_merge(first, middle, last);
+            else
+                std::inplace_merge(policy, first, middle, last);
+        }
+    }
+}
+
+// Counts allocations, then allocates with malloc. The library's other forms
+// of operator new and delete, except aligned ones, call these.
+NOINLINE void* operator new(const std::size_t size)
+{
+    if (size >= heap::uncounted_size - heap::header) throw std::bad_alloc{};
+
+    for (; ; ) {
+        if (const auto base = static_cast<unsigned char*>(
+                                std::malloc(size + heap::header))) {
+            const auto stored = (heap::uncounted ? size | heap::uncounted_size
+                                                 : size);
+            std::memcpy(base, &stored, sizeof(stored));
+            if (!heap::uncounted) heap::add(size);
+            return base + heap::header;
+        }
+
+        if (const auto handler = std::get_new_handler()) handler();
+        else throw std::bad_alloc{};
+    }
+}
+
+void* operator new(const std::size_t size, const std::nothrow_t&) noexcept
+{
+    try {
+        return ::operator new(size);
+    }
+    catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+NOINLINE void operator delete(void* const p) noexcept
+{
+    if (!p) return;
+
+    const auto base = static_cast<unsigned char*>(p) - heap::header;
+    std::size_t size {};
+    std::memcpy(&size, base, sizeof(size));
+    if (!(size & heap::uncounted_size)) heap::remove(size);
+    std::free(base);
+}
+
+void operator delete(void* const p, const std::size_t) noexcept
+{
+    ::operator delete(p);
+}
+
+namespace {
+    using Duration = std::chrono::steady_clock::duration;
+
+    // Counts of page faults served without, and with, I/O, and of voluntary
+    // and involuntary context switches.
+    struct OsCounts {
+        std::uint64_t minor_faults;
+        std::uint64_t major_faults;
+        std::uint64_t context_switches;
+    };
+
+    // Counts of hardware events. Each is absent if it couldn't be counted.
+    struct HwCounts {
+        std::optional<std::uint64_t> cycles;
+        std::optional<std::uint64_t> instructions;
+        std::optional<std::uint64_t> llc_misses;
+        std::optional<std::uint64_t> dtlb_misses;
+        std::optional<std::uint64_t> branch_misses;
+    };
+
+    // The events --counters counts, and where their counts go.
+    struct HwEvent {
+        std::string_view name;
+        std::optional<std::uint64_t> HwCounts::* count;
+        std::uint32_t type;
+        std::uint64_t config;
+    };
+
+#ifdef PMB_HAVE_PERF
+    // Configures a hardware cache event, as perf_event_open(2) describes.
+    constexpr std::uint64_t cache_event(const std::uint64_t cache,
+                                        const std::uint64_t op,
+                                        const std::uint64_t result) noexcept
+    {
+        return cache | (op << 8u) | (result << 16u);
+    }
+
+    constexpr std::array<HwEvent, 5> hw_events {{
+        {"cycles", &HwCounts::cycles,
+         PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {"instructions", &HwCounts::instructions,
+         PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {"llc_misses", &HwCounts::llc_misses,
+         PERF_TYPE_HW_CACHE, cache_event(PERF_COUNT_HW_CACHE_LL,
+                                         PERF_COUNT_HW_CACHE_OP_READ,
+                                         PERF_COUNT_HW_CACHE_RESULT_MISS)},
+        {"dtlb_misses", &HwCounts::dtlb_misses,
+         PERF_TYPE_HW_CACHE, cache_event(PERF_COUNT_HW_CACHE_DTLB,
+                                         PERF_COUNT_HW_CACHE_OP_READ,
+                                         PERF_COUNT_HW_CACHE_RESULT_MISS)},
+        {"branch_misses", &HwCounts::branch_misses,
+         PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}
+    }};
+
+    // Counters for the events above, in user space, for this process and
+    // threads it creates after they're opened. Counters that can't be opened
+    // (due to the hardware, virtualization, or perf_event_paranoid) are
+    // skipped.
+    // Counts are scaled up if the kernel multiplexed counters.
+    class PerfCounters {
+    public:
+        PerfCounters() noexcept
+        {
+            for (std::size_t i = 0u; i != hw_events.size(); ++i) {
+                perf_event_attr attr {};
+                attr.size = sizeof(attr);
+                attr.type = hw_events[i].type;
+                attr.config = hw_events[i].config;
+                attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+                                    | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                attr.inherit = 1u;
+                attr.exclude_kernel = 1u;
+                attr.exclude_hv = 1u;
+
+                fds_[i] = static_cast<int>(::syscall(SYS_perf_event_open,
+                                                     &attr, 0, -1, -1, 0ul));
+            }
+        }
+
+        PerfCounters(const PerfCounters&) = delete;
+        PerfCounters& operator=(const PerfCounters&) = delete;
+
+        ~PerfCounters()
+        {
+            for (const auto fd : fds_)
+                if (fd >= 0) ::close(fd);
+        }
+
+        [[nodiscard]]
+        bool any() const noexcept
+        {
+            return std::any_of(cbegin(fds_), cend(fds_),
+                               [](const int fd) { return fd >= 0; });
+        }
+
+        [[nodiscard]]
+        HwCounts read() const noexcept
+        {
+            HwCounts counts {};
+
+            for (std::size_t i = 0u; i != hw_events.size(); ++i) {
+                std::array<std::uint64_t, 3> values {}; // value, enabled, run
+                if (fds_[i] < 0 || ::read(fds_[i], values.data(),
+                                          sizeof(values)) != sizeof(values))
+                    continue;
+
+                const auto [value, enabled, running] = values;
+                const auto whole = running == 0u || running == enabled;
+                counts.*hw_events[i].count = (whole
+                        ? value
+                        : static_cast<std::uint64_t>(
+                            static_cast<double>(value)
+                                * static_cast<double>(enabled)
+                                / static_cast<double>(running)));
+            }
+
+            return counts;
+        }
+
+    private:
+        std::array<int, hw_events.size()> fds_ {};
+    };
+
+    // The hardware counters, once --counters has opened them.
+    [[nodiscard]]
+    std::optional<PerfCounters>& perf_counters() noexcept
+    {
+        static std::optional<PerfCounters> counters;
+        return counters;
+    }
+#endif
+
+    // Opens hardware counters. This should happen before any threads start,
+    // so they're counted too.
+    void open_counters()
+    {
+#ifdef PMB_HAVE_PERF
+        if (!perf_counters().emplace().any()) {
+            die("can't open any hardware counters (is perf_event_paranoid"
+                " too high, or is this a virtual machine?)");
+        }
+#else
+        die("hardware counters are unsupported here");
+#endif
+    }
+
+    // Bytes and number of allocations through operator new, bytes live, and
+    // the peak of live bytes since it was last reset. In a difference between
+    // two readings, live is the change, and peak is the most live beyond what
+    // was live at the first reading.
+    struct HeapCounts {
+        std::uint64_t heap_allocated;
+        std::uint64_t heap_allocations;
+        std::uint64_t heap_live;
+        std::uint64_t heap_peak;
+    };
+
+    // Reads a size, given in kB, from the process's status, by its key.
+    [[nodiscard]]
+    std::optional<std::uint64_t>
+    status_bytes([[maybe_unused]] const std::string_view key)
+    {
+#ifdef PMB_HAVE_PROCFS
+        std::ifstream status {"/proc/self/status"};
+        for (std::string line; std::getline(status, line); ) {
+            if (line.compare(0u, key.size(), key) == 0)
+                return std::uint64_t{std::stoull(line.substr(key.size()))}
+                        * 1024u;
+        }
+#endif
+        return std::nullopt;
+    }
+
+    // Reads the peak resident set size since it was last reset.
+    [[nodiscard]]
+    std::optional<std::uint64_t> peak_rss()
+    {
+        return status_bytes("VmHWM:");
+    }
+
+    // Makes the peak resident set size start over from the current size.
+    void reset_peak_rss()
+    {
+#ifdef PMB_HAVE_PROCFS
+        std::ofstream{"/proc/self/clear_refs"} << "5";
+#endif
+    }
+
+    // Tasks the work-stealing pool forked, and how many of those were stolen.
+    struct PoolCounts {
+        std::uint64_t forked;
+        std::uint64_t stolen;
+    };
+
+    // What the operating system, hardware, heap, and pool counted, and the
+    // peak resident set size since it was last reset, where known.
+    struct Counts {
+        std::optional<OsCounts> os;
+        std::optional<HwCounts> hw;
+        std::optional<HeapCounts> heap;
+        std::optional<std::uint64_t> peak_rss;
+        std::optional<PoolCounts> pool;
+    };
+
+    // Whether stages run at the same time (see --instances and --pipeline).
+    // The counts are the whole process's, so they'd mix those stages', and
+    // stages count nothing while this is set.
+    bool concurrent_stages = false;
+
+    // Reads the process's counts so far.
+    [[nodiscard]]
+    Counts read_counts()
+    {
+        Counts counts {};
+
+#ifdef PMB_HAVE_RUSAGE
+        if (rusage usage {}; getrusage(RUSAGE_SELF, &usage) == 0) {
+            const auto count = [](const long n) {
+                return static_cast<std::uint64_t>(n);
+            };
+
+            counts.os = OsCounts{count(usage.ru_minflt),
+                                 count(usage.ru_majflt),
+                                 count(usage.ru_nvcsw)
+                                    + count(usage.ru_nivcsw)};
+        }
+#endif
+
+#ifdef PMB_HAVE_PERF
+        if (const auto& perf = perf_counters()) counts.hw = perf->read();
+#endif
+
+        counts.heap = HeapCounts{heap::allocated, heap::allocations,
+                                 heap::live, heap::peak};
+        counts.peak_rss = peak_rss();
+
+        const auto [forked, stolen] = pool::counts();
+        counts.pool = PoolCounts{forked, stolen};
+
+        return counts;
+    }
+
+    // Resets peaks, then reads the process's counts so far, as a stage starts.
+    // The heap is reset and read last, since the other reads and resets
+    // allocate (for file streams), and that shouldn't count toward the stage.
+    [[nodiscard]]
+    Counts start_counts()
+    {
+        reset_peak_rss();
+        auto counts = read_counts();
+
+        heap::reset_peak();
+        counts.heap->heap_allocated = heap::allocated;
+        counts.heap->heap_allocations = heap::allocations;
+        counts.heap->heap_live = heap::live;
+        counts.heap->heap_peak = heap::peak;
+        return counts;
+    }
+
+    // Finds how much was counted between two readings.
+    [[nodiscard]]
+    Counts operator-(const Counts& after, const Counts& before) noexcept
+    {
+        Counts diff {};
+
+        if (after.os && before.os) {
+            diff.os = OsCounts{
+                after.os->minor_faults - before.os->minor_faults,
+                after.os->major_faults - before.os->major_faults,
+                after.os->context_switches - before.os->context_switches
+            };
+        }
+
+        if (after.hw && before.hw) {
+            const auto sub = [](const std::optional<std::uint64_t>& a,
+                                const std::optional<std::uint64_t>& b) {
+                return (a && b ? std::optional{*a - *b} : std::nullopt);
+            };
+
+            diff.hw = HwCounts{sub(after.hw->cycles, before.hw->cycles),
+                               sub(after.hw->instructions,
+                                   before.hw->instructions),
+                               sub(after.hw->llc_misses, before.hw->llc_misses),
+                               sub(after.hw->dtlb_misses,
+                                   before.hw->dtlb_misses),
+                               sub(after.hw->branch_misses,
+                                   before.hw->branch_misses)};
+        }
+
+        if (after.heap && before.heap) {
+            const auto& a = *after.heap;
+            const auto& b = *before.heap;
+            diff.heap = HeapCounts{a.heap_allocated - b.heap_allocated,
+                                   a.heap_allocations - b.heap_allocations,
+                                   a.heap_live - b.heap_live,
+                                   (a.heap_peak > b.heap_live
+                                        ? a.heap_peak - b.heap_live : 0u)};
+        }
+
+        diff.peak_rss = after.peak_rss;
+
+        if (after.pool && before.pool) {
+            diff.pool = PoolCounts{after.pool->forked - before.pool->forked,
+                                   after.pool->stolen - before.pool->stolen};
+        }
+
+        return diff;
+    }
+
+    // The name of a stage of a test, how much it accessed, how long one run
+    // of it took, and what was counted during it. Bytes are counted once per
+    // pass that reads or writes.
+    struct StageTiming {
+        std::string name;
+        std::size_t elements;
+        std::uint64_t bytes;
+        Duration elapsed;
+        Counts counts;
+    };
+
+    // The timings of each stage of one run of a test, in the order they ran.
+    using TrialTimings = std::vector<StageTiming>;
+
+    // How fast a stage went, normalized by how much it accessed.
+    struct Throughput {
+        double gib_per_s;
+        double elements_per_s;
+        double ns_per_element;
+    };
+
+    // Computes throughput, if the time wasn't too short to measure.
+    [[nodiscard]]
+    std::optional<Throughput> throughput(const std::size_t elements,
+                                         const std::uint64_t bytes,
+                                         const Duration dt)
+    {
+        static constexpr auto gibi =
+                static_cast<double>(std::uint64_t{1} << 30);
+
+        if (dt == Duration::zero() || elements == 0u) return std::nullopt;
+
+        const auto seconds = std::chrono::duration<double>{dt}.count();
+        const auto count = static_cast<double>(elements);
+
+        return Throughput{static_cast<double>(bytes) / gibi / seconds,
+                          count / seconds, seconds * 1e9 / count};
+    }
+
+    [[nodiscard]]
+    std::optional<Throughput> throughput(const StageTiming& stage)
+    {
+        return throughput(stage.elements, stage.bytes, stage.elapsed);
+    }
+
+    // Formats a size in the largest binary unit it has at least one of.
+    [[nodiscard]]
+    std::string format_bytes(const std::uint64_t bytes)
+    {
+        static constexpr std::array<std::string_view, 4> units {
+            "bytes", "KiB", "MiB", "GiB"
+        };
+
+        auto value = static_cast<double>(bytes);
+        std::size_t unit {};
+        for (; value >= 1024.0 && unit + 1u != units.size(); ++unit)
+            value /= 1024.0;
+
+        return (unit == 0u ? fmt::format("{} {}", bytes, units[unit])
+                           : fmt::format("{:.1f} {}", value, units[unit]));
+    }
+
+    // Reporters for the bench() function templates.
+    namespace report {
+        // Prints a stage's time and, if it can be computed, its throughput.
+        constexpr auto time_only = [](const StageTiming& stage) {
+            fmt::print(console, " ({} ms", stage.elapsed / 1ms);
+
+            if (const auto tp = throughput(stage)) {
+                fmt::print(console,
+                           "; {:.2f} GiB/s, {:.1f} Melem/s,"
+                           " {:.2f} ns/elem",
+                           tp->gib_per_s, tp->elements_per_s / 1e6,
+                           tp->ns_per_element);
+            }
+
+            if (const auto& os = stage.counts.os) {
+                if (os->minor_faults || os->major_faults) {
+                    fmt::print(console, "; {} page fault{}", os->minor_faults,
+                               (os->minor_faults == 1u ? "" : "s"));
+                }
+                if (os->major_faults)
+                    fmt::print(console, ", {} major", os->major_faults);
+
+                // Show context switches only with the hardware counters, to
+                // keep lines short, since a stage usually has a few of them.
+                if (stage.counts.hw) {
+                    fmt::print(console, "; {} context switch{}",
+                               os->context_switches,
+                               (os->context_switches == 1u ? "" : "es"));
+                }
+            }
+
+            if (const auto& heap = stage.counts.heap;
+                    heap && heap->heap_peak) {
+                fmt::print(console, "; heap +{}",
+                           format_bytes(heap->heap_peak));
+            }
+
+            if (const auto& pool = stage.counts.pool; pool && pool->forked) {
+                fmt::print(console, "; {} of {} task{} stolen", pool->stolen,
+                           pool->forked, (pool->forked == 1u ? "" : "s"));
+            }
+
+            if (const auto& hw = stage.counts.hw) {
+                if (hw->cycles && hw->instructions && *hw->cycles) {
+                    fmt::print(console, "; IPC {:.2f}",
+                               static_cast<double>(*hw->instructions)
+                                    / static_cast<double>(*hw->cycles));
+                }
+
+                // Report misses per thousand instructions.
+                const auto mpki = [&](const char* const label,
+                                      const std::optional<std::uint64_t>& n) {
+                    if (n && hw->instructions && *hw->instructions) {
+                        fmt::print(console, ", {} {:.2f} MPKI", label,
+                                   static_cast<double>(*n) * 1000.0
+                                    / static_cast<double>(*hw->instructions));
+                    }
+                };
+
+                mpki("LLC", hw->llc_misses);
+                mpki("dTLB", hw->dtlb_misses);
+                mpki("branch", hw->branch_misses);
+            }
+
+            fmt::print(console, ")\n");
+        };
+
+        constexpr auto compact = [](const StageTiming& stage) {
+            fmt::print(console, "Done.");
+            time_only(stage);
+        };
+
+        constexpr auto full = [](const auto dt) {
+            fmt::print(console,
+                       "\nTest completed in about {:.1f} seconds ({} ms).\n",
+                       dt / 1.0s, dt / 1ms);
+        };
+
+        // Makes a reporter that records a stage's timing, then passes it on
+        // to a reporter for stages. Counts start from when the reporter is
+        // made, which is just before bench() starts the stage, unless stages
+        // are concurrent.
+        template<typename Reporter>
+        [[nodiscard]]
+        auto recording(TrialTimings& timings, StageTiming stage,
+                       const Reporter& reporter)
+        {
+            const auto before = (concurrent_stages ? Counts{}
+                                                   : start_counts());
+
+            return [&timings, stage = std::move(stage), &reporter,
+                    before](const Duration dt) mutable {
+                stage.elapsed = dt;
+                if (!concurrent_stages) {
+                    stage.counts = read_counts() - before;
+                    if (heap::hidden) stage.counts.heap.reset();
+                }
+                timings.push_back(stage);
+                reporter(stage);
+            };
+        }
+    }
+
+    // Calls a medadic functor and returns its result or, if void, a monostate.
+    template<typename Action>
+    decltype(auto) call(Action&& action)
+    {
+        using Ret = decltype(std::forward<Action>(action)());
+
+        static_assert(!std::is_same_v<std::decay_t<Ret>, std::monostate>,
+                      "monostate as a real result would be ambiguous");
+
+        if constexpr (std::is_same_v<Ret, void>) {
+            std::forward<Action>(action)();
+            return std::monostate{};
+        }
+        else return std::forward<Action>(action)();
+    }
+
+    // Times an action and passes its duration to a reporter. (Results shouldn't
+    // be reported if the task throws an exception, so I did it this way and not
+    // with an RAII class whose destructor reports. But I could've made and used
+    // such a class, if it only reported when std::uncaught_exceptions() == 0.)
+    template<typename Reporter, typename Action>
+    decltype(auto) bench(Reporter&& reporter, Action&& action)
+    {
+        using clock = std::chrono::steady_clock;
+
+        const auto ti = clock::now();
+#ifdef _MSC_VER
+#pragma warning(suppress: 26496) // https://stackoverflow.com/a/48263092
+#endif
+        decltype(auto) ret = call(std::forward<Action>(action));
+        const auto tf = clock::now();
+
+        std::forward<Reporter>(reporter)(tf - ti);
+        return ret;
+    }
+
+    // The labeled stages running now, on any thread, for --sample to report.
+    // They're only tracked while sampling, so other runs just check a flag.
+    namespace live {
+        using clock = std::chrono::steady_clock;
+
+        struct Stage {
+            std::uint64_t id;
+            std::string label;
+            std::FILE* console; // where the stage's label was printed
+            clock::time_point start;
+            int reports; // progress reports printed since the label
+        };
+
+        std::atomic<bool> tracking {false};
+        std::mutex mutex;
+        std::vector<Stage> stages; // guarded by mutex
+        std::uint64_t last_id {0u}; // guarded by mutex
+
+        // Tracks a stage until it is stopped or destroyed.
+        class Watch {
+        public:
+            explicit Watch(const std::string_view label)
+            {
+                if (!tracking) return;
+
+                // This is for the sampler, so it's not the stage's memory.
+                const heap::Uncounted uncounted;
+
+                const std::lock_guard lock {mutex};
+                id_ = ++last_id;
+                stages.push_back({*id_, std::string{label}, console,
+                                  clock::now(), 0});
+            }
+
+            Watch(const Watch&) = delete;
+            Watch& operator=(const Watch&) = delete;
+
+            ~Watch() { stop(); }
+
+            // Stops tracking, so no more progress is shown after the label.
+            void stop()
+            {
+                if (!id_) return;
+
+                const std::lock_guard lock {mutex};
+                stages.erase(std::find_if(begin(stages), end(stages),
+                                          [this](const Stage& stage) {
+                    return stage.id == *id_;
+                }));
+                id_.reset();
+            }
+
+        private:
+            std::optional<std::uint64_t> id_;
+        };
+    }
+
+    // Prints an action's name, times it, and passes its duration to a reporter.
+    // While sampling, it's tracked as a live stage until the reporter runs.
+    template<typename Reporter, typename Action>
+    decltype(auto) bench(const std::string_view label,
+                         Reporter&& reporter, Action&& action)
+    {
+        fmt::print(console, "{}... ", label);
+        std::fflush(console);
+
+        live::Watch watch {label};
+        return bench([&watch, &reporter](const Duration dt) {
+            watch.stop();
+            std::forward<Reporter>(reporter)(dt);
+        }, std::forward<Action>(action));
+    }
+
+    // Calls a unary functor on each index in [0, count), using a policy.
+    template<typename Func>
+    void for_each_index(const ParallelMode& mode, const std::size_t count,
+                        const Func& func)
+    {
+        using It = boost::counting_iterator<std::size_t>;
+
+        visit([&](auto policy) {
+            algo::for_each(policy, It{0u}, It{count}, func);
+        }, mode);
+    }
+
+    // Reduces a unary functor's results on each index in [0, count), using a
+    // policy. The reduction must be associative and commutative.
+    template<typename T, typename Reduce, typename Func>
+    [[nodiscard]]
+    T transform_reduce_index(const ParallelMode& mode, const std::size_t count,
+                             T init, const Reduce& reduce, const Func& func)
+    {
+        using It = boost::counting_iterator<std::size_t>;
+
+        return visit([&](auto policy) {
+            return algo::transform_reduce(policy, It{0u}, It{count},
+                                         std::move(init), reduce, func);
+        }, mode);
+    }
+
+    // Placing memory on NUMA nodes, with system calls (so libnuma isn't
+    // needed). Everything here is Linux-only.
+    namespace numa {
+        using topology::make_mask;
+        using topology::mask_bits;
+
+        // For mbind(2), from <numaif.h>.
+        constexpr int mpol_bind {2};
+        constexpr int mpol_interleave {3};
+
+#ifdef PMB_HAVE_NUMA
+        // Finds which node the calling thread is running on.
+        [[nodiscard]]
+        unsigned current_node() noexcept
+        {
+            unsigned cpu {}, node {};
+            if (::syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) return 0u;
+            return node;
+        }
+
+        // Sets the memory policy of a page-aligned range, before it's touched.
+        void bind(void* const p, const std::size_t length, const int policy,
+                  const std::vector<unsigned>& node_ids)
+        {
+            const auto mask = make_mask(node_ids);
+
+            // The kernel expects one more than the number of bits in the mask.
+            if (::syscall(SYS_mbind, p, length, policy, mask.data(),
+                          mask.size() * mask_bits + 1u, 0u) != 0)
+                die(fmt::format("can't set NUMA policy: {}",
+                                std::strerror(errno)));
+        }
+
+        // Places memory as a mode says. Under firsttouch, one thread per CPU,
+        // pinned to that CPU's node, touches its share of the units (pages).
+        // Each node gets a contiguous share, in proportion to its CPUs.
+        void place(const NumaMode& numa, char* const p,
+                   const std::size_t length, const std::size_t unit)
+        {
+            const auto all = topology::nodes();
+            if (all.empty()) die("can't find this system's NUMA nodes");
+
+            visit(MultiLambda{
+                [&](NumaLocal) {
+                    bind(p, length, mpol_bind, {current_node()});
+                },
+                [&](NumaInterleave) {
+                    std::vector<unsigned> ids;
+                    for (const auto& node : all) ids.push_back(node.id);
+                    bind(p, length, mpol_interleave, ids);
+                },
+                [&](NumaFirstTouch) {
+                    std::size_t cpu_count {};
+                    for (const auto& node : all) cpu_count += node.cpus.size();
+
+                    const auto units = length / unit;
+                    std::vector<std::thread> threads;
+                    std::size_t cpus_before {};
+
+                    for (const auto& node : all) {
+                        for (std::size_t i = 0u; i != node.cpus.size(); ++i) {
+                            const auto first = units * cpus_before / cpu_count;
+                            ++cpus_before;
+                            const auto last = units * cpus_before / cpu_count;
+
+                            threads.emplace_back([&node, p, unit, first, last] {
+                                topology::pin_current_thread(node.cpus);
+                                for (auto j = first; j != last; ++j)
+                                    p[j * unit] = 0;
+                            });
+                        }
+                    }
+
+                    for (auto& thread : threads) thread.join();
+                }
+            }, numa);
+        }
+
+        // Finds how many bytes of the mapping containing an address are on
+        // each node, from /proc/self/maps and /proc/self/numa_maps.
+        [[nodiscard]]
+        std::vector<std::pair<unsigned, std::uint64_t>>
+        usage(const void* const address)
+        {
+            const auto target = reinterpret_cast<std::uintptr_t>(address);
+            std::string start;
+
+            std::ifstream maps {"/proc/self/maps"};
+            for (std::string line; std::getline(maps, line); ) {
+                const auto dash = line.find('-');
+                const auto space = line.find(' ');
+                if (dash == std::string::npos || space == std::string::npos)
+                    continue;
+
+                const auto lo = std::stoull(line.substr(0u, dash), nullptr, 16);
+                const auto hi = std::stoull(line.substr(dash + 1u,
+                                                        space - dash - 1u),
+                                            nullptr, 16);
+                if (lo <= target && target < hi) {
+                    start = line.substr(0u, dash);
+                    break;
+                }
+            }
+
+            std::vector<std::pair<unsigned, std::uint64_t>> ret;
+            if (start.empty()) return ret;
+
+            std::ifstream numa_maps {"/proc/self/numa_maps"};
+            for (std::string line; std::getline(numa_maps, line); ) {
+                std::stringstream fields {line};
+                std::string field;
+                if (!(fields >> field) || field != start) continue;
+
+                std::uint64_t page_kib {4u};
+                std::vector<std::pair<unsigned, std::uint64_t>> pages;
+
+                while (fields >> field) {
+                    const auto eq = field.find('=');
+                    if (eq == std::string::npos) continue;
+
+                    const auto key = field.substr(0u, eq);
+                    const auto value = std::stoull(field.substr(eq + 1u));
+
+                    if (key == "kernelpagesize_kB") {
+                        page_kib = value;
+                    }
+                    else if (key.size() > 1u && key[0] == 'N'
+                            && std::isdigit(
+                                static_cast<unsigned char>(key[1]))) {
+                        pages.emplace_back(
+                            static_cast<unsigned>(std::stoul(key.substr(1u))),
+                            value);
+                    }
+                }
+
+                for (const auto& [node, count] : pages)
+                    ret.emplace_back(node, count * page_kib * 1024u);
+                break;
+            }
+
+            return ret;
+        }
+#endif
+    }
+
+#ifdef PMB_HAVE_MMAP_FILES
+    // A file mapped as the array (see --input and --output), so the file's
+    // pages are the array's storage and nothing is copied. An input is mapped
+    // privately, so sorting doesn't change it. An output is mapped shared, so
+    // generating writes it, until it is saved. It's opened when first mapped.
+    class MappedFile {
+    public:
+        MappedFile(std::filesystem::path path, const bool output,
+                   const std::size_t bytes) noexcept
+            : path_{std::move(path)}, output_{output}, bytes_{bytes}
+        {
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile(MappedFile&&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile& operator=(MappedFile&&) = delete;
+
+        ~MappedFile()
+        {
+            if (address_) ::munmap(address_, length_);
+            if (fd_ != -1) ::close(fd_);
+        }
+
+        // Maps length bytes of the file, if the array needs the file's size
+        // and the file isn't mapped already. Otherwise returns null, so the
+        // array can be allocated another way.
+        [[nodiscard]]
+        char* map(const std::size_t bytes, const std::size_t length,
+                  [[maybe_unused]] const bool populate)
+        {
+            if (address_ || bytes != bytes_) return nullptr;
+            if (fd_ == -1) open();
+
+            auto flags = (output_ ? MAP_SHARED : MAP_PRIVATE);
+#ifdef MAP_POPULATE
+            if (populate) flags |= MAP_POPULATE;
+#endif
+
+            const auto p = ::mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                                  flags, fd_, 0);
+            if (p == MAP_FAILED) fail("map");
+
+            address_ = static_cast<char*>(p);
+            length_ = length;
+            return address_;
+        }
+
+        // Unmaps the file, if it is mapped at p.
+        [[nodiscard]]
+        bool unmap(const void* const p) noexcept
+        {
+            if (!address_ || p != address_) return false;
+
+            ::munmap(address_, length_);
+            address_ = nullptr;
+            return true;
+        }
+
+        // Writes an output's pages to the file, then maps it privately in the
+        // same place, so later changes to the array aren't saved.
+        void save()
+        {
+            if (!output_ || !address_) return;
+
+            if (::msync(address_, length_, MS_SYNC) != 0) fail("write");
+            if (::mmap(address_, length_, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_FIXED, fd_, 0) == MAP_FAILED)
+                fail("remap");
+        }
+
+    private:
+        void open()
+        {
+            fd_ = (output_ ? ::open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC,
+                                    0644)
+                           : ::open(path_.c_str(), O_RDONLY));
+            if (fd_ == -1) fail("open");
+
+            if (output_ && ::ftruncate(fd_, static_cast<off_t>(bytes_)) != 0)
+                fail("resize");
+        }
+
+        [[noreturn]]
+        void fail(const std::string_view action) const
+        {
+            die(fmt::format("can't {} {}: {}", action, path_.string(),
+                            std::strerror(errno)));
+        }
+
+        std::filesystem::path path_;
+        bool output_;
+        std::size_t bytes_;
+        int fd_ {-1};
+        char* address_ {};
+        std::size_t length_ {};
+    };
+#endif
+
+    // Allocates the array as --alloc says. Mapped memory comes zeroed from the
+    // system, so only the default mode value-initializes. Mapped allocations
+    // are rounded up to whole pages (huge pages, for hugepage), and aligned to
+    // them, so transparent huge pages can back all of a hugepage allocation.
+    template<typename T>
+    class Allocator {
+    public:
+        using value_type = T;
+
+        // With an input or output file, the first allocation of the whole
+        // array maps the file. Copies share it, so they can free it.
+        explicit Allocator(const Parameters& params)
+            : alloc_{params.alloc}, mode_{params.mode}, numa_{params.numa},
+              advice_{params.advice}
+        {
+#ifdef PMB_HAVE_MMAP_FILES
+            const auto& path = (params.input ? params.input : params.output);
+            if (path) {
+                file_ = std::make_shared<MappedFile>(
+                            *path, !params.input, params.length * sizeof(T));
+            }
+#endif
+        }
+
+        template<typename U>
+        Allocator(const Allocator<U>& other) noexcept
+            : alloc_{other.alloc()}, mode_{other.mode()}, numa_{other.numa()},
+              advice_{other.advice()}, file_{other.file()}
+        {
+        }
+
+        [[nodiscard]]
+        T* allocate(const std::size_t n)
+        {
+            if (n > std::numeric_limits<std::size_t>::max() / sizeof(T))
+                throw std::bad_alloc{};
+
+            if (!is_mapped()) {
+                return static_cast<T*>(::operator new(n * sizeof(T)));
+            }
+
+#ifdef PMB_HAVE_MMAP
+            const auto length = mapped_length(n);
+
+#ifdef PMB_HAVE_MMAP_FILES
+            if (file_) {
+                const auto populate =
+                        std::holds_alternative<PrefaultAlloc>(alloc_);
+                if (const auto p = file_->map(n * sizeof(T), length,
+                                              populate)) {
+                    advise(p, length);
+                    return reinterpret_cast<T*>(p);
+                }
+            }
+#endif
+
+            auto p = (huge() ? map_hugetlb(length) : nullptr);
+
+            if (!p) {
+                p = map_aligned(length, alignment());
+                if (!p) throw std::bad_alloc{};
+#ifdef MADV_HUGEPAGE
+                if (huge()) ::madvise(p, length, MADV_HUGEPAGE);
+#endif
+            }
+
+            advise(p, length);
+
+#ifdef PMB_HAVE_NUMA
+            if (numa_) numa::place(*numa_, p, length, alignment());
+#endif
+
+            const auto touched = numa_
+                    && std::holds_alternative<NumaFirstTouch>(*numa_);
+
+            if (std::holds_alternative<PrefaultAlloc>(alloc_) && !touched) {
+                const auto page = page_size();
+                for_each_index(mode_, length / page, [p, page](
+                        const std::size_t i) noexcept {
+                    p[i * page] = 0;
+                });
+            }
+
+            return reinterpret_cast<T*>(p);
+#else
+            NOT_REACHED();
+#endif
+        }
+
+        void deallocate(T* const p, const std::size_t n) noexcept
+        {
+            if (!is_mapped()) {
+                ::operator delete(p);
+                return;
+            }
+
+#ifdef PMB_HAVE_MMAP
+#ifdef PMB_HAVE_MMAP_FILES
+            if (file_ && file_->unmap(p)) return;
+#endif
+            ::munmap(p, mapped_length(n));
+#else
+            static_cast<void>(n);
+            NOT_REACHED();
+#endif
+        }
+
+        template<typename U, typename... Args>
+        void construct(U* const p, Args&&... args)
+        {
+            if constexpr (sizeof...(Args) == 0u) {
+                if (std::holds_alternative<DefaultAlloc>(alloc_))
+                    ::new(static_cast<void*>(p)) U();
+                else
+                    ::new(static_cast<void*>(p)) U;
+            }
+            else ::new(static_cast<void*>(p)) U(std::forward<Args>(args)...);
+        }
+
+        [[nodiscard]]
+        const AllocMode& alloc() const noexcept { return alloc_; }
+
+        [[nodiscard]]
+        const ParallelMode& mode() const noexcept { return mode_; }
+
+        [[nodiscard]]
+        const std::optional<NumaMode>& numa() const noexcept { return numa_; }
+
+        [[nodiscard]]
+        const std::optional<Advice>& advice() const noexcept { return advice_; }
+
+#ifdef PMB_HAVE_MMAP_FILES
+        [[nodiscard]]
+        const std::shared_ptr<MappedFile>& file() const noexcept
+        {
+            return file_;
+        }
+#else
+        [[nodiscard]]
+        std::nullptr_t file() const noexcept { return nullptr; }
+#endif
+
+        // Saves an output file's contents, if there is one (see MappedFile).
+        void save() const
+        {
+#ifdef PMB_HAVE_MMAP_FILES
+            if (file_) file_->save();
+#endif
+        }
+
+        template<typename U>
+        [[nodiscard]]
+        bool operator==(const Allocator<U>& other) const noexcept
+        {
+            return alloc_.index() == other.alloc().index();
+        }
+
+        template<typename U>
+        [[nodiscard]]
+        bool operator!=(const Allocator<U>& other) const noexcept
+        {
+            return !(*this == other);
+        }
+
+    private:
+        static constexpr std::size_t huge_page_size {std::size_t{1} << 21};
+
+        [[nodiscard]]
+        bool is_mapped() const noexcept
+        {
+            return !std::holds_alternative<DefaultAlloc>(alloc_)
+                && !std::holds_alternative<UninitAlloc>(alloc_);
+        }
+
+        [[nodiscard]]
+        bool huge() const noexcept
+        {
+            return std::holds_alternative<HugePageAlloc>(alloc_);
+        }
+
+#ifdef PMB_HAVE_MMAP
+        [[nodiscard]]
+        static std::size_t page_size() noexcept
+        {
+            return static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        }
+
+        [[nodiscard]]
+        std::size_t alignment() const noexcept
+        {
+            return (huge() ? huge_page_size : page_size());
+        }
+
+        [[nodiscard]]
+        std::size_t mapped_length(const std::size_t n) const noexcept
+        {
+            const auto align = alignment();
+            return (std::max(n * sizeof(T), std::size_t{1}) + align - 1u)
+                    / align * align;
+        }
+
+        // Tells the system how the mapping will be accessed, if --madvise did.
+        void advise([[maybe_unused]] char* const p,
+                    [[maybe_unused]] const std::size_t length) const noexcept
+        {
+            if (!advice_) return;
+
+            const auto flag = visit(MultiLambda{
+                [](AdviseSequential) noexcept { return MADV_SEQUENTIAL; },
+                [](AdviseRandom) noexcept { return MADV_RANDOM; },
+                [](AdviseWillNeed) noexcept { return MADV_WILLNEED; }
+            }, *advice_);
+
+            ::madvise(p, length, flag);
+        }
+
+        // Maps anonymous memory, or returns null on failure.
+        [[nodiscard]]
+        static char* map(const std::size_t length, const int flags) noexcept
+        {
+            const auto p = ::mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+            return (p == MAP_FAILED ? nullptr : static_cast<char*>(p));
+        }
+
+        // Maps explicit huge pages, which fails unless some are reserved.
+        [[nodiscard]]
+        static char* map_hugetlb([[maybe_unused]] const std::size_t length)
+            noexcept
+        {
+#ifdef MAP_HUGETLB
+            return map(length, MAP_HUGETLB);
+#else
+            return nullptr;
+#endif
+        }
+
+        // Maps memory, then trims the mapping to start on a multiple of align.
+        [[nodiscard]]
+        static char* map_aligned(const std::size_t length,
+                                 const std::size_t align) noexcept
+        {
+            const auto p = map(length + align, 0);
+            if (!p) return nullptr;
+
+            const auto misalign = reinterpret_cast<std::uintptr_t>(p) % align;
+            const auto head = (align - misalign) % align;
+            if (head != 0u) ::munmap(p, head);
+            ::munmap(p + head + length, align - head);
+            return p + head;
+        }
+#endif
+
+        AllocMode alloc_;
+        ParallelMode mode_;
+        std::optional<NumaMode> numa_;
+        std::optional<Advice> advice_;
+#ifdef PMB_HAVE_MMAP_FILES
+        std::shared_ptr<MappedFile> file_;
+#else
+        std::nullptr_t file_ {};
+#endif
+    };
+
+    // The array that is generated, hashed, sorted, and checked.
+    template<typename T>
+    using Array = std::vector<T, Allocator<T>>;
+
+    // Samples a Zipf distribution on 1, ..., n, where the probability of k is
+    // proportional to k to the power of minus the exponent. This is W. Hörmann
+    // and G. Derflinger's rejection-inversion method, in "Rejection-inversion
+    // to generate variates from monotone discrete distributions" (1996), as
+    // adapted by Apache Commons RNG. It takes constant expected time.
+    class ZipfSampler {
+    public:
+        ZipfSampler(const std::uint64_t n, const double exponent)
+            : n_{static_cast<double>(n)}, exponent_{exponent},
+              h_integral_x1_{h_integral(1.5) - 1.0},
+              h_integral_n_{h_integral(n_ + 0.5)},
+              s_{2.0 - h_integral_inverse(h_integral(2.5) - h(2.0))}
+        {
+            assert(n > 0u);
+            assert(exponent > 0.0);
+        }
+
+        template<typename Engine>
+        [[nodiscard]]
+        std::uint64_t operator()(Engine& gen) const
+        {
+            for (; ; ) {
+                const auto u = h_integral_n_
+                        + std::generate_canonical<double, 53>(gen)
+                            * (h_integral_x1_ - h_integral_n_);
+
+                const auto x = h_integral_inverse(u);
+                const auto k = std::clamp(std::floor(x + 0.5), 1.0, n_);
+
+                if (k - x <= s_ || u >= h_integral(k + 0.5) - h(k))
+                    return static_cast<std::uint64_t>(k);
+            }
+        }
+
+    private:
+        // log(1 + x) / x, continued to 1 at 0.
+        [[nodiscard]]
+        static double helper1(const double x) noexcept
+        {
+            return (std::abs(x) > 1e-8 ? std::log1p(x) / x
+                                       : 1.0 - x * (0.5 - x / 3.0));
+        }
+
+        // (exp(x) - 1) / x, continued to 1 at 0.
+        [[nodiscard]]
+        static double helper2(const double x) noexcept
+        {
+            return (std::abs(x) > 1e-8 ? std::expm1(x) / x
+                                       : 1.0 + x * 0.5 * (1.0 + x / 3.0));
+        }
+
+        [[nodiscard]]
+        double h(const double x) const noexcept
+        {
+            return std::exp(-exponent_ * std::log(x));
+        }
+
+        [[nodiscard]]
+        double h_integral(const double x) const noexcept
+        {
+            const auto log_x = std::log(x);
+            return helper2((1.0 - exponent_) * log_x) * log_x;
+        }
+
+        [[nodiscard]]
+        double h_integral_inverse(const double x) const noexcept
+        {
+            const auto t = std::max(x * (1.0 - exponent_), -1.0);
+            return std::exp(helper1(t) * x);
+        }
+
+        double n_;
+        double exponent_;
+        double h_integral_x1_;
+        double h_integral_n_;
+        double s_;
+    };
+
+    // Scrambles bits, so nearby ranks are far apart. This is the finalizer of
+    // splitmix64 (http://prng.di.unimi.it/splitmix64.c).
+    [[nodiscard]]
+    constexpr std::uint64_t mix64(std::uint64_t x) noexcept
+    {
+        x = (x ^ (x >> 30u)) * 0xBF58476D1CE4E5B9u;
+        x = (x ^ (x >> 27u)) * 0x94D049BB133111EBu;
+        return x ^ (x >> 31u);
+    }
+
+    // Finds the position of i in [0, n) as a fraction in [0, 1).
+    [[nodiscard]]
+    double unit(const std::uint64_t i, const std::uint64_t n) noexcept
+    {
+        static constexpr auto below_one = 1.0 - 0x1p-53;
+
+        return std::min(static_cast<double>(i) / static_cast<double>(n),
+                        below_one);
+    }
+
+    // Fills out[0, last - first) with elements [first, last) of an input of
+    // the chosen distribution and length. So an input can be made in pieces
+    // (see --external), without room for all of it.
+    template<typename T, typename Engine>
+    void generate_span(const Distribution& dist, T* const out,
+                       const std::size_t first, const std::size_t last,
+                       const std::size_t length, Engine& gen)
+    {
+        using Traits = ElementTraits<T>;
+
+        // Gets the element at an index of the whole input.
+        const auto at = [out, first](const std::size_t i) -> T& {
+            return out[i - first];
+        };
+
+        // Fills the range with elements each made from its index.
+        const auto fill = [&](const auto& unit_at) {
+            for (auto i = first; i != last; ++i)
+                at(i) = Traits::from_unit(unit_at(i), gen);
+        };
+
+        visit(MultiLambda{
+            [&](Uniform) {
+                std::generate(out, out + (last - first),
+                              [&gen] { return Traits::make(gen); });
+            },
+            [&](Sorted) {
+                fill([length](const std::size_t i) { return unit(i, length); });
+            },
+            [&](Reversed) {
+                fill([length](const std::size_t i) {
+                    return unit(length - 1u - i, length);
+                });
+            },
+            [&](const NearlySorted& d) {
+                fill([length](const std::size_t i) { return unit(i, length); });
+
+                const auto count = static_cast<std::size_t>(std::llround(
+                        static_cast<double>(last - first) * d.swap_percent
+                            / 100.0));
+
+                if (last - first < 2u) return;
+                std::uniform_int_distribution<std::size_t> index {first,
+                                                                  last - 1u};
+                for (std::size_t j = 0u; j != count; ++j)
+                    std::swap(at(index(gen)), at(index(gen)));
+            },
+            [&](const FewUnique& d) {
+                std::uniform_int_distribution<std::uint64_t> value {
+                    0u, d.count - 1u};
+                for (auto i = first; i != last; ++i)
+                    at(i) = Traits::from_unit(unit(value(gen), d.count), gen);
+            },
+            [&](const Zipf& d) {
+                const ZipfSampler rank {std::max(std::uint64_t{length},
+                                                 std::uint64_t{1}),
+                                        d.exponent};
+
+                for (auto i = first; i != last; ++i) {
+                    at(i) = Traits::from_unit(
+                            static_cast<double>(mix64(rank(gen)) >> 11u)
+                                * 0x1p-53,
+                            gen);
+                }
+            },
+            [&](OrganPipe) {
+                const auto half = length / 2u + length % 2u;
+                fill([length, half](const std::size_t i) {
+                    return unit(std::min(i, length - 1u - i), half);
+                });
+            }
+        }, dist);
+    }
+
+    // Fills a[first, last) with part of an input of the chosen distribution.
+    template<typename T, typename Engine>
+    void generate_range(const Distribution& dist, Array<T>& a,
+                        const std::size_t first, const std::size_t last,
+                        Engine& gen)
+    {
+        generate_span(dist, a.data() + first, first, last, a.size(), gen);
+    }
+
+    // Fills out[0, last - first) with elements [first, last) of an input of
+    // the chosen distribution and length, in blocks, each from its own engine
+    // seeded with the seed and the block's index. So the result depends only
+    // on the seed, not the policy or how many threads run. The range must
+    // start at a block.
+    template<typename T>
+    void generate_blockwise_span(const ParallelMode& mode,
+                                 const Distribution& dist, T* const out,
+                                 const std::size_t first,
+                                 const std::size_t last,
+                                 const std::size_t length,
+                                 const unsigned seed)
+    {
+        using Traits = ElementTraits<T>;
+
+        assert(first % generation_block_length == 0u);
+        const auto first_block = first / generation_block_length;
+        const auto block_count = (last - first) / generation_block_length
+                + ((last - first) % generation_block_length != 0u);
+
+        for_each_index(mode, block_count, [&](const std::size_t offset) {
+            const auto block = first_block + offset;
+            using Word = std::uint_least32_t;
+            const std::uint_least64_t wide_block {block};
+            std::seed_seq seq {Word{seed},
+                               gsl::narrow_cast<Word>(wide_block),
+                               gsl::narrow_cast<Word>(wide_block >> 32u)};
+            typename Traits::Engine gen {seq};
+
+            const auto block_first = block * generation_block_length;
+            const auto block_last = std::min(
+                    block_first + generation_block_length, last);
+            generate_span(dist, out + (block_first - first), block_first,
+                          block_last, length, gen);
+        });
+    }
+
+    // Fills an array with elements of the chosen distribution, in seeded
+    // blocks (see generate_blockwise_span).
+    template<typename T>
+    void generate_blockwise(const ParallelMode& mode, const Distribution& dist,
+                            Array<T>& a, const unsigned seed)
+    {
+        generate_blockwise_span(mode, dist, a.data(), 0u, a.size(), a.size(),
+                                seed);
+    }
+
+    // Elements per block, when each block gets its own radix sort histogram.
+    constexpr std::size_t radix_block_length {std::size_t{1} << 18};
+
+    // Sorts with LSD radix sort, a byte at a time. Each pass counts digits in
+    // each block in parallel, computes where each block's elements of each
+    // digit go, then scatters the blocks in parallel into a scratch buffer. A
+    // pass is skipped if all elements have the same digit. This is stable.
+    template<typename T>
+    void radix_sort(const ParallelMode& mode, Array<T>& a)
+    {
+        using Traits = ElementTraits<T>;
+        using Key = decltype(Traits::radix_key(std::declval<const T&>()));
+        using Histogram = std::array<std::size_t, 256>;
+
+        const auto length = a.size();
+        const auto block_count = length / radix_block_length
+                                    + (length % radix_block_length != 0u);
+
+        Array<T> scratch (length, a.get_allocator());
+        std::vector<Histogram> counts (block_count);
+        auto src = &a, dest = &scratch;
+
+        for (auto shift = 0u; shift != sizeof(Key) * CHAR_BIT; shift += 8u) {
+            const auto digit = [shift](const T& x) noexcept {
+                return static_cast<std::size_t>(
+                        (Traits::radix_key(x) >> shift) & Key{0xFF});
+            };
+
+            const auto for_each_block = [&](const auto& func) {
+                for_each_index(mode, block_count, [&](const std::size_t block) {
+                    const auto first = block * radix_block_length;
+                    func(block, first,
+                         std::min(first + radix_block_length, length));
+                });
+            };
+
+            for_each_block([&](const std::size_t block, const std::size_t first,
+                               const std::size_t last) {
+                auto& count = counts[block];
+                count.fill(0u);
+                for (auto i = first; i != last; ++i) ++count[digit((*src)[i])];
+            });
+
+            // Turn counts into starting offsets, digit-major, block-minor.
+            auto skip = false;
+            for (std::size_t d = 0u, offset = 0u; d != 256u; ++d) {
+                const auto start = offset;
+                for (auto& count : counts)
+                    offset += std::exchange(count[d], offset);
+                if (offset - start == length) skip = true;
+            }
+            if (skip) continue;
+
+            for_each_block([&](const std::size_t block, const std::size_t first,
+                               const std::size_t last) {
+                auto& offsets = counts[block];
+                for (auto i = first; i != last; ++i)
+                    (*dest)[offsets[digit((*src)[i])]++] = (*src)[i];
+            });
+
+            std::swap(src, dest);
+        }
+
+        if (src != &a) {
+            visit([&](auto policy) {
+                algo::copy(policy, cbegin(*src), cend(*src), begin(a));
+            }, mode);
+        }
+    }
+
+    // How many threads the parameters call for: --threads, or one per CPU.
+    [[nodiscard]]
+    unsigned thread_count(const Parameters& params) noexcept
+    {
+        return (params.threads != 0u
+                    ? params.threads
+                    : std::max(std::thread::hardware_concurrency(), 1u));
+    }
+
+    // Elements per run that merge sort sorts before it starts merging.
+    constexpr std::size_t merge_run_length {std::size_t{1} << 16};
+
+    // Sorts with merge sort: sorts runs in parallel, then merges pairs of
+    // adjacent runs in rounds. While there are enough pairs to keep threads
+    // busy (with as many threads as the parameters call for), pairs are merged
+    // in parallel, each sequentially. After that, each pair is merged with
+    // std::inplace_merge under the execution policy.
+    template<typename T>
+    void merge_sort(const Parameters& params, const ParallelMode& mode,
+                    Array<T>& a)
+    {
+        const auto length = a.size();
+        const auto at = [&a](const std::size_t i) {
+            return begin(a) + gsl::narrow_cast<std::ptrdiff_t>(i);
+        };
+
+        const auto run_count = length / merge_run_length
+                                + (length % merge_run_length != 0u);
+
+        for_each_index(mode, run_count, [&](const std::size_t run) {
+            const auto first = run * merge_run_length;
+            const auto last = std::min(first + merge_run_length, length);
+            std::sort(at(first), at(last));
+        });
+
+        const auto threads = thread_count(params);
+        const auto sequential = std::holds_alternative<sequenced_policy>(mode);
+
+        for (auto width = merge_run_length; width < length; width *= 2u) {
+            const auto pair_count = length / (width * 2u)
+                                    + (length % (width * 2u) > width);
+
+            const auto merge = [&](const std::size_t pair, auto policy) {
+                const auto first = pair * width * 2u;
+                const auto mid = first + width;
+                const auto last = std::min(mid + width, length);
+                algo::inplace_merge(policy, at(first), at(mid), at(last));
+            };
+
+            if (sequential || pair_count >= threads) {
+                for_each_index(mode, pair_count, [&](const std::size_t pair) {
+                    merge(pair, seq);
+                });
+            }
+            else {
+                for (std::size_t pair = 0u; pair != pair_count; ++pair)
+                    visit([&](auto policy) { merge(pair, policy); }, mode);
+            }
+        }
+    }
+
+    // Elements samplesort samples per bucket, so buckets come out about even.
+    constexpr std::size_t sample_oversampling {32u};
+
+    // Below this length, samplesort just sorts the whole array.
+    constexpr std::size_t sample_min_length {std::size_t{1} << 16};
+
+    // How long each phase of a samplesort took, how many elements it
+    // sampled, and how many buckets it made.
+    struct SortPhases {
+        Duration sample;
+        Duration scatter;
+        Duration local;
+        std::size_t samples;
+        std::size_t buckets;
+    };
+
+    // Sorts with samplesort: sorts a random sample and takes evenly spaced
+    // splitters from it, then counts and scatters blocks of elements into
+    // buckets in parallel through a scratch buffer as large as the array,
+    // then sorts each bucket, and copies it back, in parallel. Elements equal
+    // to a splitter share a bucket, so repeated keys don't make empty ones.
+    template<typename T>
+    SortPhases sample_sort(const Parameters& params, Array<T>& a)
+    {
+        using clock = std::chrono::steady_clock;
+
+        const auto length = a.size();
+        const auto& mode = params.mode;
+        const auto t0 = clock::now();
+
+        if (length < sample_min_length) {
+            visit([&](auto policy) {
+                algo::sort(policy, begin(a), end(a));
+            }, mode);
+            return {{}, {}, clock::now() - t0, 0u, 1u};
+        }
+
+        const auto wanted = (params.buckets != 0u
+                                ? params.buckets
+                                : std::clamp(gsl::narrow<std::size_t>(
+                                                length * sizeof(T)
+                                                    / params.bucket_bytes
+                                                    + 1u),
+                                             std::size_t{2}, max_buckets));
+
+        std::mt19937 gen {params.seed};
+        std::uniform_int_distribution<std::size_t> pick {0u, length - 1u};
+        std::vector<T> sample (std::min(wanted * sample_oversampling, length));
+        for (auto& x : sample) x = a[pick(gen)];
+        std::sort(begin(sample), end(sample));
+
+        std::vector<T> splitters;
+        for (std::size_t i = 1u; i != wanted; ++i)
+            splitters.push_back(sample[i * sample.size() / wanted]);
+        splitters.erase(std::unique(begin(splitters), end(splitters),
+                                    [](const T& x, const T& y) {
+                            return !(x < y);
+                        }),
+                        end(splitters));
+
+        const auto bucket_count = splitters.size() + 1u;
+        const auto bucket_of = [&splitters](const T& x) {
+            return static_cast<std::size_t>(
+                    std::upper_bound(cbegin(splitters), cend(splitters), x)
+                        - cbegin(splitters));
+        };
+
+        const auto t1 = clock::now();
+
+        // A few blocks per thread, so the counts stay small.
+        const auto threads = thread_count(params);
+        const auto block_length = std::max(length / (threads * 4u) + 1u,
+                                           sample_min_length);
+        const auto block_count = length / block_length
+                                    + (length % block_length != 0u);
+
+        Array<T> scratch (length, a.get_allocator());
+        std::vector<std::size_t> counts (block_count * bucket_count);
+
+        const auto for_each_block = [&](const auto& func) {
+            for_each_index(mode, block_count, [&](const std::size_t block) {
+                const auto first = block * block_length;
+                func(block * bucket_count, first,
+                     std::min(first + block_length, length));
+            });
+        };
+
+        for_each_block([&](const std::size_t row, const std::size_t first,
+                           const std::size_t last) {
+            for (auto i = first; i != last; ++i)
+                ++counts[row + bucket_of(a[i])];
+        });
+
+        // Turn counts into offsets, bucket-major, block-minor.
+        std::vector<std::size_t> starts (bucket_count + 1u);
+        for (std::size_t bucket = 0u, offset = 0u; bucket != bucket_count;
+                ++bucket) {
+            starts[bucket] = offset;
+            for (std::size_t block = 0u; block != block_count; ++block) {
+                offset += std::exchange(counts[block * bucket_count + bucket],
+                                        offset);
+            }
+        }
+        starts.back() = length;
+
+        for_each_block([&](const std::size_t row, const std::size_t first,
+                           const std::size_t last) {
+            for (auto i = first; i != last; ++i)
+                scratch[counts[row + bucket_of(a[i])]++] = a[i];
+        });
+
+        const auto t2 = clock::now();
+
+        const auto at = [](Array<T>& array, const std::size_t i) {
+            return begin(array) + gsl::narrow_cast<std::ptrdiff_t>(i);
+        };
+
+        for_each_index(mode, bucket_count, [&](const std::size_t bucket) {
+            const auto first = at(scratch, starts[bucket]);
+            const auto last = at(scratch, starts[bucket + 1u]);
+            std::sort(first, last);
+            std::copy(first, last, at(a, starts[bucket]));
+        });
+
+        return {t1 - t0, t2 - t1, clock::now() - t2, sample.size(),
+                bucket_count};
+    }
+
+    // Records and prints how long each phase of a samplesort took, as
+    // stages named after the sort's own stage.
+    void report_phases(TrialTimings& timings, const std::string& name,
+                       const SortPhases& phases, const std::size_t length,
+                       const std::size_t element_bytes)
+    {
+        const auto bytes = std::uint64_t{length} * element_bytes;
+
+        timings.push_back({name + " (sample)", phases.samples,
+                           std::uint64_t{phases.samples} * element_bytes,
+                           phases.sample, {}});
+        timings.push_back({name + " (scatter)", length, bytes * 3u,
+                           phases.scatter, {}});
+        timings.push_back({name + " (local sort)", length, bytes * 4u,
+                           phases.local, {}});
+
+        fmt::print(console,
+                   "Phases... sample {:.1f} ms, scatter {:.1f} ms,"
+                   " local sort {:.1f} ms ({} bucket{}).\n",
+                   phases.sample / 1.0ms, phases.scatter / 1.0ms,
+                   phases.local / 1.0ms, phases.buckets,
+                   (phases.buckets == 1u ? "" : "s"));
+    }
+
+    // Finds where an algorithm that only sorts or partitions part of the array
+    // should divide it.
+    [[nodiscard]]
+    std::size_t middle_index(const Parameters& params) noexcept
+    {
+        const auto length = static_cast<double>(params.length);
+        return std::min(static_cast<std::size_t>(length * params.middle),
+                        params.length);
+    }
+
+    // Sorts with one kernel: an algorithm, with a policy, on an element type.
+    // The algorithms that take a mode still take it as a variant, which they
+    // visit once, outside their loops.
+    template<typename Algorithm, typename Policy, typename T>
+    std::optional<SortPhases> sort_kernel(const Parameters& params,
+                                          const Policy policy, Array<T>& a)
+    {
+        const auto middle = begin(a)
+                + gsl::narrow_cast<std::ptrdiff_t>(middle_index(params));
+
+        if constexpr (std::is_same_v<Algorithm, StdSort>)
+            algo::sort(policy, begin(a), end(a));
+        else if constexpr (std::is_same_v<Algorithm, StableSort>)
+            algo::stable_sort(policy, begin(a), end(a));
+        else if constexpr (std::is_same_v<Algorithm, PartialSort>)
+            algo::partial_sort(policy, begin(a), middle, end(a));
+        else if constexpr (std::is_same_v<Algorithm, NthElement>)
+            algo::nth_element(policy, begin(a), middle, end(a));
+        else if constexpr (std::is_same_v<Algorithm, MergeSort>)
+            merge_sort(params, ParallelMode{policy}, a);
+        else if constexpr (std::is_same_v<Algorithm, RadixSort>)
+            radix_sort(ParallelMode{policy}, a);
+        else {
+            static_assert(std::is_same_v<Algorithm, SampleSort>);
+            return sample_sort(params, a);
+        }
+
+        return std::nullopt;
+    }
+
+    // Sorts, partially sorts, or partitions an array, with the chosen
+    // algorithm and execution policy. Returns the phases, for samplesort.
+    template<typename T>
+    std::optional<SortPhases> sort(const Parameters& params, Array<T>& a)
+    {
+        return visit([&](auto algorithm, auto policy)
+                        -> std::optional<SortPhases> {
+            using Algorithm = decltype(algorithm);
+            using Policy = decltype(policy);
+
+            // Parameters name only kernels the build has (see configure()).
+            if constexpr (has_sort_kernel<Algorithm, Policy, T>)
+                return sort_kernel<Algorithm>(params, policy, a);
+            else NOT_REACHED();
+        }, params.algorithm, params.mode);
+    }
+
+    // Elements per block, when hashing and checking split the array.
+    constexpr std::size_t verify_block_length {std::size_t{1} << 16};
+
+    // Number of verify_block_length blocks covering count elements.
+    [[nodiscard]]
+    constexpr std::size_t verify_block_count(const std::size_t count) noexcept
+    {
+        return count / verify_block_length
+                + (count % verify_block_length != 0u);
+    }
+
+    // Sums the mixed values of count words of the given size. They are read
+    // with memcpy, so this works on the bits of any element type that size.
+    template<typename Word>
+    [[nodiscard]]
+    inline std::uint64_t mix_sum(const unsigned char* const bytes,
+                                 const std::size_t count) noexcept
+    {
+        std::uint64_t sum {};
+
+        for (std::size_t i = 0u; i != count; ++i) {
+            Word word {};
+            std::memcpy(&word, bytes + i * sizeof word, sizeof word);
+            sum += mix64(word);
+        }
+
+        return sum;
+    }
+
+    [[nodiscard]] MULTIVERSION
+    std::uint64_t mix_sum_32(const unsigned char* const bytes,
+                             const std::size_t count) noexcept
+    {
+        return mix_sum<std::uint32_t>(bytes, count);
+    }
+
+    [[nodiscard]] MULTIVERSION
+    std::uint64_t mix_sum_64(const unsigned char* const bytes,
+                             const std::size_t count) noexcept
+    {
+        return mix_sum<std::uint64_t>(bytes, count);
+    }
+
+    // Checks that no element is less than the one before. This doesn't stop
+    // at the first descent, so that it vectorizes.
+    template<typename T>
+    [[nodiscard]]
+    inline bool ascending(const T* const p, const std::size_t count) noexcept
+    {
+        unsigned descents {};
+        for (std::size_t i = 1u; i < count; ++i) descents |= (p[i] < p[i - 1u]);
+        return descents == 0u;
+    }
+
+    // Vectorized kernels for ascending_block(). A build that leaves out a
+    // type's sorting kernels leaves its kernel here unused.
+    [[nodiscard]] [[maybe_unused]] MULTIVERSION
+    bool ascending_u32(const std::uint32_t* const p,
+                       const std::size_t count) noexcept
+    {
+        return ascending(p, count);
+    }
+
+    [[nodiscard]] [[maybe_unused]] MULTIVERSION
+    bool ascending_u64(const std::uint64_t* const p,
+                       const std::size_t count) noexcept
+    {
+        return ascending(p, count);
+    }
+
+    [[nodiscard]] [[maybe_unused]] MULTIVERSION
+    bool ascending_f32(const float* const p, const std::size_t count) noexcept
+    {
+        return ascending(p, count);
+    }
+
+    [[nodiscard]] [[maybe_unused]] MULTIVERSION
+    bool ascending_f64(const double* const p, const std::size_t count) noexcept
+    {
+        return ascending(p, count);
+    }
+
+    // Checks that [p, p + count) is sorted, using the vectorized kernel for
+    // the type if there is one.
+    template<typename T>
+    [[nodiscard]]
+    bool ascending_block(const T* const p, const std::size_t count) noexcept
+    {
+        if constexpr (std::is_same_v<T, std::uint32_t>)
+            return ascending_u32(p, count);
+        else if constexpr (std::is_same_v<T, std::uint64_t>)
+            return ascending_u64(p, count);
+        else if constexpr (std::is_same_v<T, float>)
+            return ascending_f32(p, count);
+        else if constexpr (std::is_same_v<T, double>)
+            return ascending_f64(p, count);
+        else
+            return std::is_sorted(p, p + count);
+    }
+
+    // Checks that the first count elements are sorted, a block at a time.
+    // Each block also checks the first element of the next block.
+    template<typename T>
+    [[nodiscard]]
+    bool is_sorted_prefix(const ParallelMode& mode, const Array<T>& a,
+                          const std::size_t count)
+    {
+        return transform_reduce_index(mode, verify_block_count(count), true,
+                                      std::logical_and<>{},
+                                      [&](const std::size_t block) {
+            const auto first = block * verify_block_length;
+            const auto last = std::min(first + verify_block_length + 1u,
+                                       count);
+            return ascending_block(a.data() + first, last - first);
+        });
+    }
+
+    // Whether an array is as sorted as it should be, and a short description.
+    struct OrderCheck {
+        bool ok;
+        std::string_view description;
+    };
+
+    // Checks that an array is as sorted as the algorithm should have made it.
+    template<typename T>
+    [[nodiscard]]
+    OrderCheck check_order(const Parameters& params, const Array<T>& a)
+    {
+        const auto middle_pos = middle_index(params);
+        const auto middle = cbegin(a)
+                + gsl::narrow_cast<std::ptrdiff_t>(middle_pos);
+
+        // Checks that no element in [first, last) is out of order, in parallel.
+        const auto none_of = [&](const auto first, const auto last,
+                                 const auto& out_of_order) {
+            return visit([&](auto policy) {
+                return algo::none_of(policy, first, last, out_of_order);
+            }, params.mode);
+        };
+
+        return visit(MultiLambda{
+            [&](auto) {
+                const auto ok = is_sorted_prefix(params.mode, a, a.size());
+                return OrderCheck{ok, (ok ? "sorted." : "NOT SORTED!")};
+            },
+            [&](PartialSort) {
+                const auto ok = is_sorted_prefix(params.mode, a, middle_pos)
+                                && (middle == cbegin(a)
+                                    || none_of(middle, cend(a),
+                                               [&](const T& x) {
+                                        return x < *std::prev(middle);
+                                    }));
+                return OrderCheck{ok, (ok ? "sorted up to the middle."
+                                          : "NOT SORTED!")};
+            },
+            [&](NthElement) {
+                const auto ok = middle == cend(a)
+                                || (none_of(cbegin(a), middle,
+                                            [&](const T& x) {
+                                        return *middle < x;
+                                    })
+                                    && none_of(middle, cend(a),
+                                               [&](const T& x) {
+                                        return x < *middle;
+                                    }));
+                return OrderCheck{ok, (ok ? "partitioned."
+                                          : "NOT PARTITIONED!")};
+            }
+        }, params.algorithm);
+    }
+
+    // Sums the mixed hash words of [p, p + count), using the vectorized
+    // kernel for the type's size if its hash word is just its bits.
+    template<typename T>
+    [[nodiscard]]
+    std::uint64_t checksum_block(const T* const p,
+                                 const std::size_t count) noexcept
+    {
+        using Traits = ElementTraits<T>;
+        const auto bytes = reinterpret_cast<const unsigned char*>(p);
+
+        if constexpr (std::is_arithmetic_v<T> && sizeof(T) == 4u)
+            return mix_sum_32(bytes, count);
+        else if constexpr (std::is_arithmetic_v<T> && sizeof(T) == 8u)
+            return mix_sum_64(bytes, count);
+        else {
+            return std::accumulate(p, p + count, std::uint64_t{},
+                                   [](const std::uint64_t acc, const T& x) {
+                return acc + mix64(Traits::hash(x));
+            });
+        }
+    }
+
+    // Computes the order-independent checksum of an array's elements: the sum
+    // of their mixed hash words. Unlike a plain sum of the words, changes that
+    // keep the sum (like x + 1 and y - 1) almost always change this.
+    template<typename T>
+    [[nodiscard]]
+    std::uint64_t checksum(const ParallelMode& mode, const Array<T>& a)
+    {
+        const auto length = a.size();
+
+        return transform_reduce_index(mode, verify_block_count(length),
+                                      std::uint64_t{}, std::plus<>{},
+                                      [&](const std::size_t block) {
+            const auto first = block * verify_block_length;
+            const auto last = std::min(first + verify_block_length, length);
+            return checksum_block(a.data() + first, last - first);
+        });
+    }
+
+    // Computes a checksum of each block of an array, in parallel, to find
+    // where a difference is. Records are summed by key only, since sorts
+    // that aren't stable may put records with the same key in any order.
+    template<typename T>
+    [[nodiscard]]
+    std::vector<std::uint64_t> block_checksums(const ParallelMode& mode,
+                                               const Array<T>& a)
+    {
+        using Traits = ElementTraits<T>;
+
+        const auto length = a.size();
+        std::vector<std::uint64_t> sums (verify_block_count(length));
+
+        for_each_index(mode, sums.size(), [&](const std::size_t block) {
+            const auto first = block * verify_block_length;
+            const auto last = std::min(first + verify_block_length, length);
+
+            if constexpr (std::is_arithmetic_v<T>)
+                sums[block] = checksum_block(a.data() + first, last - first);
+            else {
+                sums[block] = std::accumulate(
+                        a.data() + first, a.data() + last, std::uint64_t{},
+                        [](const std::uint64_t acc, const T& x) {
+                    return acc + mix64(std::uint64_t{Traits::radix_key(x)});
+                });
+            }
+        });
+
+        return sums;
+    }
+
+    // Keeps a result the compiler would otherwise see is unused.
+    template<typename T>
+    void keep(const T value) noexcept
+    {
+        [[maybe_unused]] static volatile T sink {};
+        sink = value;
+    }
+
+    // Runs one bandwidth kernel over a and two arrays, b and c, of the same
+    // length. Only numeric element types are accepted (see --kernel).
+    template<typename T>
+    void run_kernel(const ParallelMode& mode, const Kernel& kernel,
+                    Array<T>& a, Array<T>& b, Array<T>& c)
+    {
+        static_assert(std::is_arithmetic_v<T>);
+        constexpr auto q = T{3};
+
+        visit([&](auto policy) {
+            visit(MultiLambda{
+                [&](CopyKernel) {
+                    algo::copy(policy, cbegin(a), cend(a), begin(c));
+                },
+                [&](ScaleKernel) {
+                    algo::transform(policy, cbegin(c), cend(c), begin(b),
+                                   [&](const T x) noexcept {
+                        return static_cast<T>(q * x);
+                    });
+                },
+                [&](AddKernel) {
+                    algo::transform(policy, cbegin(a), cend(a), cbegin(b),
+                                   begin(c),
+                                   [](const T x, const T y) noexcept {
+                        return static_cast<T>(x + y);
+                    });
+                },
+                [&](TriadKernel) {
+                    algo::transform(policy, cbegin(b), cend(b), cbegin(c),
+                                   begin(a),
+                                   [&](const T x, const T y) noexcept {
+                        return static_cast<T>(x + q * y);
+                    });
+                },
+                [&](ReadKernel) {
+                    keep(algo::reduce(policy, cbegin(a), cend(a)));
+                },
+                [&](WriteKernel) {
+                    algo::fill(policy, begin(a), end(a), q);
+                }
+            }, kernel);
+        }, mode);
+    }
+
+    // Fills an array with copies of a value, using a policy (so the pages of
+    // a mapped allocation are first touched by the threads that use them).
+    template<typename T>
+    void fill(const ParallelMode& mode, Array<T>& a, const T value)
+    {
+        visit([&](auto policy) {
+            algo::fill(policy, begin(a), end(a), value);
+        }, mode);
+    }
+
+    // Prints how sorting's lower-bound bandwidth compares to the fastest
+    // kernel's, if both were measurable.
+    void print_roofline(const Parameters& params,
+                        const TrialTimings& timings)
+    {
+        const auto find = [&](const std::string_view name) {
+            const auto p = std::find_if(cbegin(timings), cend(timings),
+                                        [name](const StageTiming& stage) {
+                return stage.name == name;
+            });
+            return (p == cend(timings) ? std::nullopt : throughput(*p));
+        };
+
+        const auto sorting = find("Sorting");
+        std::optional<Throughput> best;
+        std::string_view best_name;
+
+        for (const auto& kernel : params.kernels) {
+            const auto tp = find(kernel_label(kernel));
+            if (tp && (!best || tp->gib_per_s > best->gib_per_s))
+                best = tp, best_name = kernel_name(kernel);
+        }
+
+        if (!sorting || !best || best->gib_per_s <= 0.0) return;
+
+        fmt::print(console,
+                   "Roofline... sorting moved at least {:.1f}% of {}'s"
+                   " {:.2f} GiB/s.\n",
+                   sorting->gib_per_s / best->gib_per_s * 100.0,
+                   best_name, best->gib_per_s);
+    }
+
+    // Makes the array one random cycle through all its indices, so following
+    // it from any element visits every element (Sattolo's algorithm).
+    template<typename T, typename Engine>
+    void make_cycle(Array<T>& a, Engine& gen)
+    {
+        std::iota(begin(a), end(a), T{});
+
+        for (auto i = a.size(); i > 1u; --i) {
+            std::uniform_int_distribution<std::size_t> index {0u, i - 2u};
+            std::swap(a[i - 1u], a[index(gen)]);
+        }
+    }
+
+    // Follows count links of the cycle in an array from index 0. Each load
+    // depends on the last, so this takes count times the load latency.
+    template<typename T>
+    [[nodiscard]]
+    T chase(const Array<T>& a, std::size_t count) noexcept
+    {
+        T i {};
+        for (; count != 0u; --count) i = a[i];
+        return i;
+    }
+
+    // Threads that copy and scale between their own slices of two arrays,
+    // until destroyed, so dependent loads can be timed under bandwidth load.
+    // With pinning, they take the CPUs after the main thread's.
+    template<typename T>
+    class BandwidthLoad {
+    public:
+        BandwidthLoad(const Parameters& params, Array<T>& b, Array<T>& c)
+        {
+            const auto count = std::max(thread_count(params) - 1u, 1u);
+            const auto slice = b.size() / count;
+
+            for (auto i = 0u; i != count; ++i) {
+                const auto first = i * slice;
+                const auto last = (i + 1u == count ? b.size()
+                                                   : first + slice);
+                threads_.emplace_back([this, &params, &b, &c,
+                                       first, last, i] {
+                    pin(params, i);
+                    run(b.data() + first, c.data() + first, last - first);
+                });
+            }
+        }
+
+        BandwidthLoad(const BandwidthLoad&) = delete;
+        BandwidthLoad(BandwidthLoad&&) = delete;
+        BandwidthLoad& operator=(const BandwidthLoad&) = delete;
+        BandwidthLoad& operator=(BandwidthLoad&&) = delete;
+
+        ~BandwidthLoad()
+        {
+            stop_ = true;
+            for (auto& thread : threads_) thread.join();
+        }
+
+        // How many threads are making load.
+        [[nodiscard]]
+        std::size_t size() const noexcept { return threads_.size(); }
+
+        // Bytes the threads have read and written so far.
+        [[nodiscard]]
+        std::uint64_t bytes() const noexcept { return bytes_; }
+
+    private:
+        static void pin([[maybe_unused]] const Parameters& params,
+                        [[maybe_unused]] const unsigned i) noexcept
+        {
+#ifdef PMB_HAVE_NUMA
+            if (const auto& cpus = params.pin_cpus; !cpus.empty())
+                topology::pin_current_thread({cpus[(i + 1u) % cpus.size()]});
+#endif
+        }
+
+        void run(T* const b, T* const c, const std::size_t n) noexcept
+        {
+            const auto pass_bytes = std::uint64_t{n} * sizeof(T) * 2u;
+
+            while (!stop_) {
+                std::copy(b, b + n, c);
+                std::transform(c, c + n, b, [](const T x) noexcept {
+                    return static_cast<T>(T{3} * x);
+                });
+                bytes_ += pass_bytes * 2u;
+            }
+        }
+
+        std::vector<std::thread> threads_;
+        std::atomic<bool> stop_ {false};
+        std::atomic<std::uint64_t> bytes_ {0u};
+    };
+
+    // Times dependent loads through a random cycle in the array, alone or
+    // while other threads use bandwidth, and records the chase as a stage.
+    // Its throughput, per element, is per load.
+    template<typename T, typename Stage>
+    void run_latency(const Parameters& params, Array<T>& a,
+                     TrialTimings& timings, const Stage& stage)
+    {
+        typename ElementTraits<T>::Engine gen {params.seed};
+
+        stage("Building cycle", 2, report::compact, [&] {
+            make_cycle(a, gen);
+        });
+
+        Array<T> b (a.get_allocator()), c (a.get_allocator());
+        std::optional<BandwidthLoad<T>> load;
+
+        if (std::holds_alternative<LatencyLoaded>(*params.latency)) {
+            b.resize(a.size());
+            c.resize(a.size());
+            fill(params.mode, b, T{1});
+            fill(params.mode, c, T{2});
+            load.emplace(params, b, c);
+        }
+
+        std::uint64_t load_bytes {};
+
+        const auto reporter = [&](const StageTiming& timing) {
+            const auto seconds =
+                    std::chrono::duration<double>{timing.elapsed}.count();
+
+            if (!load) fmt::print(console, "Done.");
+            else if (seconds > 0.0) {
+                fmt::print(console, "{} load thread{} at {:.2f} GiB/s.",
+                           load->size(), (load->size() == 1u ? "" : "s"),
+                           static_cast<double>(load_bytes)
+                                / static_cast<double>(std::uint64_t{1} << 30)
+                                / seconds);
+            }
+
+            report::time_only(timing);
+        };
+
+        bench("Chasing pointers",
+              report::recording(timings,
+                                StageTiming{"Chasing pointers", chase_loads,
+                                            chase_loads * sizeof(T), {}, {}},
+                                reporter),
+              [&] {
+            const auto before = (load ? load->bytes() : 0u);
+            keep(chase(a, chase_loads));
+            if (load) load_bytes = load->bytes() - before;
+        });
+    }
+
+    // Elements per block when perturbing by swaps. Each block swaps pairs of
+    // its own, with its own seeded generator, so blocks are perturbed in
+    // parallel and the result doesn't depend on the policy.
+    constexpr std::size_t perturb_block_length {std::size_t{1} << 16};
+
+    // Elements per segment that may be reversed, when perturbing by reversal.
+    constexpr std::size_t reverse_segment_length {std::size_t{1} << 10};
+
+    // Makes a generator for a block of a perturbation, seeded by the seed, the
+    // level's index (so each level perturbs differently), and the block.
+    [[nodiscard]]
+    std::mt19937_64 perturb_engine(const unsigned seed, const std::size_t round,
+                                   const std::size_t block)
+    {
+        using Word = std::uint_least32_t;
+        const std::uint_least64_t wide_block {block};
+        std::seed_seq seq {Word{seed}, gsl::narrow_cast<Word>(round),
+                           gsl::narrow_cast<Word>(wide_block),
+                           gsl::narrow_cast<Word>(wide_block >> 32u)};
+        return std::mt19937_64{seq};
+    }
+
+    // Swaps random pairs of elements within each block, so about the given
+    // fraction of elements is moved.
+    template<typename T>
+    void perturb_swaps(const ParallelMode& mode, Array<T>& a,
+                       const double level, const unsigned seed,
+                       const std::size_t round)
+    {
+        const auto n = a.size();
+        const auto blocks = n / perturb_block_length
+                + (n % perturb_block_length != 0u);
+
+        for_each_index(mode, blocks, [&](const std::size_t block) {
+            auto gen = perturb_engine(seed, round, block);
+            const auto first = block * perturb_block_length;
+            const auto length = std::min(perturb_block_length, n - first);
+            const auto swaps = static_cast<std::size_t>(
+                    std::llround(level * static_cast<double>(length) / 2.0));
+            std::uniform_int_distribution<std::size_t> index {
+                    first, first + length - 1u};
+
+            for (std::size_t i = 0u; i != swaps; ++i) {
+                const auto j = index(gen);
+                const auto k = index(gen);
+                std::swap(a[j], a[k]);
+            }
+        });
+    }
+
+    // Moves an evenly spread sample of the given fraction of the elements to
+    // the end, in scrambled order, leaving the rest in order before them (as
+    // if unsorted records were appended to sorted ones). Each element's new
+    // position is computed from its old one, so all move in parallel, through
+    // a scratch buffer.
+    template<typename T>
+    void perturb_tail(const ParallelMode& mode, Array<T>& a,
+                      const double level, const unsigned seed,
+                      const std::size_t round)
+    {
+        const auto n = a.size();
+        const auto k = std::min(static_cast<std::size_t>(std::llround(
+                                        level * static_cast<double>(n))),
+                                n / 2u);
+        if (k == 0u) return;
+
+        // The sample is every stride-th element. The tail's order is an affine
+        // permutation, i -> (i * multiplier + offset) mod k, which scrambles
+        // it when the multiplier is coprime with k and not near 0 or k. The
+        // multiplier is also kept small enough that the product can't wrap.
+        const auto stride = n / k;
+        const auto limit = std::numeric_limits<std::uint64_t>::max() / k;
+        auto multiplier = std::max(std::uint64_t{1u}, std::min(
+                static_cast<std::uint64_t>(static_cast<double>(k) * 0.618),
+                limit));
+        while (std::gcd(multiplier, std::uint64_t{k}) != 1u) --multiplier;
+        const auto offset = perturb_engine(seed, round, 0u)() % k;
+
+        std::vector<T> b (n);
+
+        for_each_index(mode, n, [&](const std::size_t p) {
+            if (p % stride == 0u && p / stride < k) {
+                b[n - k + (p / stride * multiplier + offset) % k] =
+                        std::move(a[p]);
+            }
+            else b[p - std::min(p / stride + 1u, k)] = std::move(a[p]);
+        });
+
+        for_each_index(mode, n, [&](const std::size_t p) {
+            a[p] = std::move(b[p]);
+        });
+    }
+
+    // Reverses segments, each with probability of the given fraction.
+    template<typename T>
+    void perturb_reverse(const ParallelMode& mode, Array<T>& a,
+                         const double level, const unsigned seed,
+                         const std::size_t round)
+    {
+        const auto n = a.size();
+        const auto segments = n / reverse_segment_length
+                + (n % reverse_segment_length != 0u);
+        const auto salt = mix64((std::uint64_t{seed} << 32u) ^ round);
+
+        for_each_index(mode, segments, [&](const std::size_t segment) {
+            const auto chance = static_cast<double>(mix64(salt ^ segment)
+                                                    >> 11u) * 0x1p-53;
+            if (chance >= level) return;
+
+            const auto first = segment * reverse_segment_length;
+            const auto last = std::min(first + reverse_segment_length, n);
+            std::reverse(a.data() + first, a.data() + last);
+        });
+    }
+
+    // Perturbs a sorted array by a fraction, in one of the ways to.
+    template<typename T>
+    void perturb(const ParallelMode& mode, const Perturbation& how,
+                 Array<T>& a, const double level, const unsigned seed,
+                 const std::size_t round)
+    {
+        visit([&](auto tag) {
+            using Tag = decltype(tag);
+
+            if constexpr (std::is_same_v<Tag, PerturbSwaps>)
+                perturb_swaps(mode, a, level, seed, round);
+            else if constexpr (std::is_same_v<Tag, PerturbTail>)
+                perturb_tail(mode, a, level, seed, round);
+            else perturb_reverse(mode, a, level, seed, round);
+        }, how);
+    }
+
+    // Elements per run that counting inversions first sorts by insertion.
+    constexpr std::size_t inversion_run_length {32u};
+
+    // Counts inversions (pairs out of order; equal elements aren't), by merge
+    // sorting a copy. Short runs are sorted by insertion, counting shifts,
+    // then runs are merged in pairs, each level in parallel, counting how many
+    // left elements each element taken from the right passes. This needs two
+    // more arrays' worth of memory, and the last levels have few pairs.
+    template<typename T>
+    [[nodiscard]]
+    std::uint64_t count_inversions(const ParallelMode& mode, const Array<T>& a)
+    {
+        const auto n = a.size();
+        const auto plus = std::plus<std::uint64_t>{};
+        std::vector<T> src (n), dst (n);
+
+        for_each_index(mode, n, [&](const std::size_t i) { src[i] = a[i]; });
+
+        const auto runs = n / inversion_run_length
+                + (n % inversion_run_length != 0u);
+
+        auto count = transform_reduce_index(mode, runs, std::uint64_t{}, plus,
+                                            [&](const std::size_t run) {
+            const auto first = run * inversion_run_length;
+            const auto last = std::min(first + inversion_run_length, n);
+            std::uint64_t shifts {};
+
+            for (auto i = first + 1u; i < last; ++i) {
+                auto x = std::move(src[i]);
+                auto j = i;
+                for (; j != first && x < src[j - 1u]; --j, ++shifts)
+                    src[j] = std::move(src[j - 1u]);
+                src[j] = std::move(x);
+            }
+
+            return shifts;
+        });
+
+        for (auto width = inversion_run_length; width < n; width *= 2u) {
+            const auto pairs = n / (width * 2u) + (n % (width * 2u) != 0u);
+
+            count += transform_reduce_index(mode, pairs, std::uint64_t{}, plus,
+                                            [&](const std::size_t pair) {
+                const auto first = pair * width * 2u;
+                const auto mid = std::min(first + width, n);
+                const auto last = std::min(mid + width, n);
+                auto left = first, right = mid, out = first;
+                std::uint64_t passed {};
+
+                while (left != mid && right != last) {
+                    if (src[right] < src[left]) {
+                        passed += mid - left;
+                        dst[out++] = std::move(src[right++]);
+                    }
+                    else dst[out++] = std::move(src[left++]);
+                }
+
+                std::move(src.data() + left, src.data() + mid,
+                          dst.data() + out);
+                std::move(src.data() + right, src.data() + last,
+                          dst.data() + out + (mid - left));
+                return passed;
+            });
+
+            std::swap(src, dst);
+        }
+
+        return count;
+    }
+
+    // After sorting, perturbs the array by each level in turn, counts its
+    // inversions, and sorts it again, recording each as a stage. Then prints
+    // how sorting time grew with disorder, compared to the first sort's.
+    template<typename T, typename Stage>
+    void run_perturbations(const Parameters& params, Array<T>& a,
+                           TrialTimings& timings, const Stage& stage)
+    {
+        struct Row {
+            double level;
+            std::uint64_t inversions;
+            StageTiming sorting;
+        };
+
+        const auto& how = *params.perturbation;
+        std::vector<Row> rows;
+
+        for (std::size_t round = 0u; round != params.perturb_levels.size();
+                ++round) {
+            const auto level = params.perturb_levels[round];
+            const auto label = fmt::format("{} {:g}%", perturbation_name(how),
+                                           level * 100.0);
+
+            stage(fmt::format("Perturbing ({})", label), 1, report::compact,
+                  [&] {
+                perturb(params.mode, how, a, level, params.seed, round);
+            });
+
+            const auto inversions = stage(
+                    fmt::format("Counting inversions ({})", label), 2,
+                    report::time_only, [&] {
+                const auto count = count_inversions(params.mode, a);
+                fmt::print(console, "{}.", count);
+                return count;
+            });
+
+            const auto name = fmt::format("Sorting ({})", label);
+            const auto phases = stage(name, 2, report::compact, [&] {
+                return sort(params, a);
+            });
+
+            rows.push_back({level, inversions, timings.back()});
+            if (phases)
+                report_phases(timings, name, *phases, a.size(), sizeof(T));
+        }
+
+        const auto first = std::find_if(cbegin(timings), cend(timings),
+                                        [](const StageTiming& timing) {
+            return timing.name == "Sorting";
+        });
+        const auto first_ms = (first == cend(timings) ? 0.0
+                : std::chrono::duration<double, std::milli>{
+                        first->elapsed}.count());
+        const auto n = static_cast<double>(a.size());
+        const auto most = n * (n - 1.0) / 2.0;
+
+        fmt::print(console, "\nSorting again after perturbing ({}):\n",
+                   perturbation_name(how));
+        fmt::print(console, "{:>10} {:>20} {:>10} {:>12} {:>9} {:>9}\n",
+                   "level", "inversions", "of most", "sort ms", "GiB/s",
+                   "vs first");
+
+        for (const auto& row : rows) {
+            const auto ms = std::chrono::duration<double, std::milli>{
+                    row.sorting.elapsed}.count();
+            const auto tp = throughput(row.sorting);
+
+            fmt::print(console, "{:>9g}% {:>20} {:>9.3g}% {:>12.3f} {:>9}"
+                                " {:>9}\n",
+                       row.level * 100.0, row.inversions,
+                       (most > 0.0 ? static_cast<double>(row.inversions)
+                                        / most * 100.0
+                                   : 0.0),
+                       ms,
+                       (tp ? fmt::format("{:.2f}", tp->gib_per_s) : "-"),
+                       (first_ms > 0.0 ? fmt::format("{:.2f}x", ms / first_ms)
+                                       : "-"));
+        }
+
+        fmt::print(console, "\n");
+    }
+
+    // Reads the resident set size before a test allocates, without what's
+    // already resident for its arrays (whose storage a sweep reuses).
+    [[nodiscard]]
+    std::optional<std::uint64_t> rss_before(const std::uint64_t array_bytes)
+    {
+        const auto rss = status_bytes("VmRSS:");
+        if (!rss) return std::nullopt;
+        return *rss - std::min(*rss, array_bytes);
+    }
+
+    // Prints the highest peak resident set size of any stage, if known, and
+    // how much that exceeds the array and what was resident before the test.
+    void print_peak_rss(const TrialTimings& timings,
+                        const std::uint64_t array_bytes,
+                        const std::optional<std::uint64_t> before)
+    {
+        std::optional<std::uint64_t> peak;
+
+        for (const auto& stage : timings) {
+            if (const auto rss = stage.counts.peak_rss)
+                peak = std::max(peak.value_or(0u), *rss);
+        }
+
+        if (!peak) return;
+
+        const auto used = array_bytes + before.value_or(0u);
+        fmt::print(console, "Peak RSS... {}, {} beyond the array{}.\n",
+                   format_bytes(*peak),
+                   format_bytes(*peak > used ? *peak - used : 0u),
+                   (before ? fmt::format(" (and {} before it)",
+                                         format_bytes(*before))
+                           : std::string{}));
+    }
+
+    // Prints how much of the mapping containing an address is on each node.
+    void print_placement([[maybe_unused]] const void* const address)
+    {
+        static constexpr auto mebi =
+                static_cast<double>(std::uint64_t{1} << 20);
+
+        fmt::print(console, "Placement... ");
+
+        const char* separator = "";
+#ifdef PMB_HAVE_NUMA
+        for (const auto& [node, bytes] : numa::usage(address)) {
+            fmt::print(console, "{}node {}: {:.1f} MiB",
+                       std::exchange(separator, ", "), node,
+                       static_cast<double>(bytes) / mebi);
+        }
+#endif
+
+        fmt::print(console, "{}.\n", (*separator ? "" : "unknown"));
+    }
+
+    // Whether a test's rehash matched its hash, and its array came out in
+    // order.
+    struct Verification {
+        bool same;
+        bool ordered;
+    };
+
+    template<typename T>
+    [[nodiscard]]
+    TrialTimings test(const Parameters& params, Array<T>& a,
+                      Verification* const verification = nullptr)
+    {
+        using Traits = ElementTraits<T>;
+
+        typename Traits::Engine gen {params.seed};
+        TrialTimings timings;
+
+        // Describes a stage that reads and/or writes the whole array in the
+        // given number of passes (a lower bound, for sorting).
+        const auto work = [&params](std::string name, const int passes) {
+            const auto bytes = std::uint64_t{params.length} * sizeof(T);
+            return StageTiming{std::move(name), params.length,
+                               bytes * gsl::narrow_cast<unsigned>(passes), {},
+                               {}};
+        };
+
+        // Benchmarks a stage, recording its timing under its label's name.
+        const auto stage = [&](const std::string_view label, const int passes,
+                               const auto& reporter, auto&& action) {
+            return bench(label,
+                         report::recording(timings,
+                                           work(std::string{label}, passes),
+                                           reporter),
+                         std::forward<decltype(action)>(action));
+        };
+
+        const auto before = rss_before(a.capacity() * sizeof(T));
+
+        // If a has enough capacity (when sweeping lengths), this only zeroes.
+        stage("Allocating/zeroing", 1, report::compact, [&] {
+            a.clear();
+            a.resize(params.length);
+        });
+
+        // An input file's pages are the array, so there's nothing to make.
+        if (!params.input) {
+            stage("Generating", 1, report::compact, [&] {
+                if (params.blockwise_generation) {
+                    generate_blockwise(params.mode, params.distribution, a,
+                                       params.seed);
+                }
+                else generate_range(params.distribution, a, 0u, a.size(), gen);
+            });
+        }
+
+        if (params.output) {
+            stage("Saving", 1, report::compact, [&] {
+                a.get_allocator().save();
+            });
+        }
+
+        if (params.numa) print_placement(a.data());
+
+        const auto s1 = stage("Hashing", 1, report::time_only, [&] {
+            const auto s = checksum(params.mode, a);
+            fmt::print(console, "{:x}.", s);
+            return s;
+        });
+
+        for (auto i = 1; i <= params.inplace_reps; ++i) {
+            // Record each repetition separately, since they differ in input.
+            const auto name = (i == 1 ? std::string{"Sorting"}
+                                      : fmt::format("Sorting #{}", i));
+
+            const auto phases = bench("Sorting",
+                                      report::recording(timings, work(name, 2),
+                                                        report::compact),
+                                      [&] {
+                return sort(params, a);
+            });
+
+            if (phases)
+                report_phases(timings, name, *phases, a.size(), sizeof(T));
+        }
+
+        // Perturbing permutes, so what's checked below is the last sort's.
+        if (params.perturbation) run_perturbations(params, a, timings, stage);
+
+        stage("Rehashing", 1, report::time_only, [&] {
+            const auto s2 = checksum(params.mode, a);
+            fmt::print(console, "{:x}, {}",
+                       s2, (s1 == s2 ? "same." : "DIFFERENT!"));
+            if (verification) verification->same = (s1 == s2);
+        });
+
+        stage("Checking", 1, report::time_only, [&] {
+            const auto order = check_order(params, a);
+            fmt::print(console, "{}", order.description);
+            if (verification) verification->ordered = order.ok;
+        });
+
+        // The kernels need arithmetic, so only numeric types can run them.
+        if constexpr (std::is_arithmetic_v<T>) {
+            if (!params.kernels.empty()) {
+                Array<T> b (a.get_allocator()), c (a.get_allocator());
+
+                stage("Preparing kernels", 2, report::compact, [&] {
+                    b.resize(a.size());
+                    c.resize(a.size());
+                    fill(params.mode, b, T{1});
+                    fill(params.mode, c, T{2});
+                });
+
+                for (const auto& kernel : params.kernels) {
+                    stage(kernel_label(kernel), kernel_passes(kernel),
+                          report::compact, [&] {
+                        run_kernel(params.mode, kernel, a, b, c);
+                    });
+                }
+
+                print_roofline(params, timings);
+            }
+        }
+
+        // The elements are the cycle's links, so only indices can chase.
+        if constexpr (std::is_integral_v<T> && std::is_unsigned_v<T>) {
+            if (params.latency) run_latency(params, a, timings, stage);
+        }
+
+        print_peak_rss(timings, a.size() * sizeof(T), before);
+        return timings;
+    }
+
+    // Sorting input too big for memory (see --external). Runs of the input,
+    // as long as a run buffer holds, are generated, sorted in memory with the
+    // chosen algorithm and policy, and written to files, then merged into one
+    // output file. Reads and writes are of big chunks, on other threads, into
+    // and out of pairs of buffers, so the CPU works on one while the other is
+    // read or written.
+    namespace external {
+        // A failure to read or write a file, which main() reports.
+        class IoError : public std::runtime_error {
+        public:
+            using std::runtime_error::runtime_error;
+        };
+
+        // Time spent in reads and writes (on I/O threads), and time the main
+        // thread spent waiting for them. The rest of a stage is CPU time.
+        struct IoTime {
+            std::atomic<Duration::rep> busy {0};
+            Duration waited {};
+        };
+
+        // Calls an action that does I/O, adding its time to the busy time.
+        template<typename Action>
+        decltype(auto) timed_io(IoTime& time, const Action& action)
+        {
+            using clock = std::chrono::steady_clock;
+
+            const auto ti = clock::now();
+            decltype(auto) ret = call(action);
+            time.busy += (clock::now() - ti).count();
+            return ret;
+        }
+
+        // Waits for an I/O task, adding to the main thread's waiting time,
+        // and returns its result (or rethrows its exception).
+        template<typename R>
+        R wait(std::future<R>& pending, IoTime& time)
+        {
+            using clock = std::chrono::steady_clock;
+
+            const auto ti = clock::now();
+            pending.wait();
+            time.waited += clock::now() - ti;
+            return pending.get();
+        }
+
+        // Opens a file for unbuffered binary I/O, since it is done in chunks.
+        template<typename Stream>
+        [[nodiscard]]
+        Stream open(const std::filesystem::path& path,
+                    const std::ios::openmode mode)
+        {
+            Stream file;
+            file.rdbuf()->pubsetbuf(nullptr, 0);
+            file.open(path, mode | std::ios::binary);
+            if (!file)
+                throw IoError{fmt::format("can't open {}", path.string())};
+            return file;
+        }
+
+        // Writes count elements to a file.
+        template<typename T>
+        void write_chunk(std::ofstream& file, const std::filesystem::path& path,
+                         const T* const data, const std::size_t count,
+                         IoTime& time)
+        {
+            timed_io(time, [&] {
+                file.write(reinterpret_cast<const char*>(data),
+                           gsl::narrow_cast<std::streamsize>(count
+                                                             * sizeof(T)));
+            });
+            if (!file)
+                throw IoError{fmt::format("can't write {}", path.string())};
+        }
+
+        // Reads up to count elements from a file, returning how many it read
+        // (fewer only at the end).
+        template<typename T>
+        [[nodiscard]]
+        std::size_t read_chunk(std::ifstream& file,
+                               const std::filesystem::path& path,
+                               T* const data, const std::size_t count,
+                               IoTime& time)
+        {
+            timed_io(time, [&] {
+                file.read(reinterpret_cast<char*>(data),
+                          gsl::narrow_cast<std::streamsize>(count * sizeof(T)));
+            });
+            if (file.bad())
+                throw IoError{fmt::format("can't read {}", path.string())};
+
+            return static_cast<std::size_t>(file.gcount()) / sizeof(T);
+        }
+
+        // The names of a sort's run files and output file, which are removed
+        // when it's done. A random tag keeps concurrent sorts apart.
+        class Scratch {
+        public:
+            Scratch(std::filesystem::path dir, const std::size_t runs)
+                : dir_{std::move(dir)}, runs_{runs},
+                  tag_{std::random_device{}()}
+            {
+            }
+
+            Scratch(const Scratch&) = delete;
+            Scratch(Scratch&&) = delete;
+            Scratch& operator=(const Scratch&) = delete;
+            Scratch& operator=(Scratch&&) = delete;
+
+            ~Scratch()
+            {
+                std::error_code ec;
+                for (std::size_t i = 0u; i != runs_; ++i)
+                    std::filesystem::remove(run(i), ec);
+                std::filesystem::remove(output(), ec);
+            }
+
+            [[nodiscard]]
+            std::filesystem::path run(const std::size_t i) const
+            {
+                return dir_ / fmt::format("pmb-{:08x}-run-{}.bin", tag_, i);
+            }
+
+            [[nodiscard]]
+            std::filesystem::path output() const
+            {
+                return dir_ / fmt::format("pmb-{:08x}-sorted.bin", tag_);
+            }
+
+        private:
+            std::filesystem::path dir_;
+            std::size_t runs_;
+            unsigned tag_;
+        };
+
+        // Reads a run file a chunk at a time, reading the next chunk into one
+        // buffer while the elements of the other are merged.
+        template<typename T>
+        class RunReader {
+        public:
+            RunReader(std::filesystem::path path, T* const first,
+                      T* const second, const std::size_t chunk, IoTime& time)
+                : path_{std::move(path)},
+                  file_{open<std::ifstream>(path_, std::ios::in)},
+                  buffers_{first, second}, chunk_{chunk}, time_{&time}
+            {
+                start();
+                advance();
+            }
+
+            RunReader(const RunReader&) = delete;
+            RunReader(RunReader&&) = delete;
+            RunReader& operator=(const RunReader&) = delete;
+            RunReader& operator=(RunReader&&) = delete;
+
+            ~RunReader() = default;
+
+            // Tells if every element has been taken.
+            [[nodiscard]]
+            bool done() const noexcept { return pos_ == end_; }
+
+            [[nodiscard]]
+            const T& front() const noexcept { return *pos_; }
+
+            // Moves to the next element, waiting for the next chunk if needed.
+            void pop()
+            {
+                if (++pos_ == end_) advance();
+            }
+
+        private:
+            void start()
+            {
+                pending_ = std::async(std::launch::async,
+                                      [this, data = buffers_[next_]] {
+                    return read_chunk(file_, path_, data, chunk_, *time_);
+                });
+            }
+
+            void advance()
+            {
+                const auto count = wait(pending_, *time_);
+                pos_ = buffers_[next_];
+                end_ = pos_ + count;
+                next_ ^= 1u;
+                if (count != 0u) start();
+            }
+
+            std::filesystem::path path_;
+            std::ifstream file_;
+            std::array<T*, 2> buffers_;
+            std::size_t chunk_;
+            IoTime* time_;
+            unsigned next_ {0u};
+            const T* pos_ {};
+            const T* end_ {};
+            std::future<std::size_t> pending_; // last, so destroyed first
+        };
+
+        // Writes a file a chunk at a time, writing one buffer while the other
+        // is filled.
+        template<typename T>
+        class ChunkWriter {
+        public:
+            ChunkWriter(std::filesystem::path path, T* const first,
+                        T* const second, const std::size_t chunk,
+                        IoTime& time)
+                : path_{std::move(path)},
+                  file_{open<std::ofstream>(path_, std::ios::out
+                                                    | std::ios::trunc)},
+                  buffers_{first, second}, chunk_{chunk}, time_{&time},
+                  pos_{first}, end_{first + chunk}
+            {
+            }
+
+            ChunkWriter(const ChunkWriter&) = delete;
+            ChunkWriter(ChunkWriter&&) = delete;
+            ChunkWriter& operator=(const ChunkWriter&) = delete;
+            ChunkWriter& operator=(ChunkWriter&&) = delete;
+
+            ~ChunkWriter() = default;
+
+            void push(const T& x)
+            {
+                *pos_++ = x;
+                if (pos_ == end_) flush();
+            }
+
+            // Writes what's left, and waits for all writes to finish.
+            void finish()
+            {
+                flush();
+                if (pending_.valid()) wait(pending_, *time_);
+            }
+
+        private:
+            void flush()
+            {
+                if (pending_.valid()) wait(pending_, *time_);
+
+                const auto data = buffers_[current_];
+                const auto count = static_cast<std::size_t>(pos_ - data);
+                if (count != 0u) {
+                    pending_ = std::async(std::launch::async,
+                                          [this, data, count] {
+                        write_chunk(file_, path_, data, count, *time_);
+                    });
+                }
+
+                current_ ^= 1u;
+                pos_ = buffers_[current_];
+                end_ = pos_ + chunk_;
+            }
+
+            std::filesystem::path path_;
+            std::ofstream file_;
+            std::array<T*, 2> buffers_;
+            std::size_t chunk_;
+            IoTime* time_;
+            unsigned current_ {0u};
+            T* pos_;
+            T* end_;
+            std::future<void> pending_; // last, so destroyed first
+        };
+
+        // Prints how a stage's time divides into I/O and CPU time, then its
+        // time and throughput.
+        [[nodiscard]]
+        auto report_io(const IoTime& io)
+        {
+            return [&io](const StageTiming& stage) {
+                const auto busy = Duration{io.busy.load()};
+                const auto cpu = stage.elapsed - std::min(io.waited,
+                                                          stage.elapsed);
+
+                fmt::print(console, " I/O busy {} ms, waited {} ms; CPU {} ms.",
+                           busy / 1ms, io.waited / 1ms, cpu / 1ms);
+                report::time_only(stage);
+            };
+        }
+
+        // Generates, sorts, and merges an input in runs, using buffer and one
+        // more array as long as a run. Times are recorded like test()'s.
+        template<typename T>
+        [[nodiscard]]
+        TrialTimings test(const Parameters& params, Array<T>& buffer)
+        {
+            using Traits = ElementTraits<T>;
+
+            const auto length = params.length;
+            const auto run_length = std::min(params.run_length, length);
+            const auto run_count = length / run_length
+                                    + (length % run_length != 0u);
+
+            const Scratch files {*params.external, run_count};
+            Array<T> spare (buffer.get_allocator());
+            IoTime io;
+            TrialTimings timings;
+
+            // Benchmarks a stage over some elements, making the given number
+            // of passes over them, and records its timing.
+            const auto stage = [&](const std::string_view label,
+                                   const std::size_t elements,
+                                   const int passes, const auto& reporter,
+                                   auto&& action) {
+                const auto bytes = std::uint64_t{elements} * sizeof(T)
+                                    * gsl::narrow_cast<unsigned>(passes);
+                return bench(label,
+                             report::recording(timings,
+                                               StageTiming{std::string{label},
+                                                           elements, bytes,
+                                                           {}, {}},
+                                               reporter),
+                             std::forward<decltype(action)>(action));
+            };
+
+            const auto before = rss_before((buffer.capacity()
+                                            + spare.capacity()) * sizeof(T));
+
+            stage("Allocating/zeroing", run_length * 2u, 1, report::compact,
+                  [&] {
+                buffer.clear();
+                buffer.resize(run_length);
+                spare.clear();
+                spare.resize(run_length);
+            });
+
+            std::uint64_t s1 {};
+
+            // Bytes are counted once, as written to the run files.
+            stage("Making runs", length, 1, report_io(io), [&] {
+                io.busy = 0;
+                io.waited = {};
+
+                const std::array<Array<T>*, 2> buffers {&buffer, &spare};
+                typename Traits::Engine gen {params.seed};
+                auto run_params = params;
+                std::array<std::future<void>, 2> writes;
+
+                for (std::size_t i = 0u; i != run_count; ++i) {
+                    auto& run = *buffers[i % 2u];
+                    auto& write = writes[i % 2u];
+                    if (write.valid()) wait(write, io);
+
+                    const auto first = i * run_length;
+                    const auto last = std::min(first + run_length, length);
+                    run.resize(last - first);
+
+                    if (params.blockwise_generation) {
+                        generate_blockwise_span(params.mode,
+                                                params.distribution,
+                                                run.data(), first, last,
+                                                length, params.seed);
+                    }
+                    else {
+                        generate_span(params.distribution, run.data(), first,
+                                      last, length, gen);
+                    }
+
+                    s1 += checksum(params.mode, run);
+                    run_params.length = run.size();
+                    sort(run_params, run);
+
+                    write = std::async(std::launch::async,
+                                       [&files, &run, &io, i] {
+                        auto file = open<std::ofstream>(files.run(i),
+                                                        std::ios::out
+                                                        | std::ios::trunc);
+                        write_chunk(file, files.run(i), run.data(),
+                                    run.size(), io);
+                    });
+                }
+
+                for (auto& write : writes)
+                    if (write.valid()) wait(write, io);
+
+                fmt::print(console, "{} run{}, {:x}.", run_count,
+                           (run_count == 1u ? "" : "s"), s1);
+            });
+
+            // Bytes are counted twice, as read from runs and written out.
+            stage("Merging", length, 2, report_io(io), [&] {
+                io.busy = 0;
+                io.waited = {};
+
+                // Each run, and the output, gets two chunks of the buffers.
+                const auto chunk = std::max(run_length / (run_count + 1u),
+                                            std::size_t{1});
+                buffer.resize(std::max(run_length, (run_count + 1u) * chunk));
+                spare.resize(buffer.size());
+                const auto slot = [&](const std::size_t i) {
+                    return (i % 2u == 0u ? buffer.data() : spare.data())
+                            + i / 2u * chunk;
+                };
+
+                std::deque<RunReader<T>> runs;
+                for (std::size_t i = 0u; i != run_count; ++i)
+                    runs.emplace_back(files.run(i), slot(2u * i),
+                                      slot(2u * i + 1u), chunk, io);
+
+                ChunkWriter<T> out {files.output(), slot(2u * run_count),
+                                    slot(2u * run_count + 1u), chunk, io};
+
+                // The heap gives the smallest head, and the earliest run's
+                // among equals, so a stable sort's runs merge stably.
+                using Head = std::pair<T, std::size_t>;
+                const auto later = [](const Head& x, const Head& y) {
+                    return y.first < x.first
+                            || (!(x.first < y.first) && y.second < x.second);
+                };
+                std::priority_queue<Head, std::vector<Head>, decltype(later)>
+                        heads {later};
+
+                for (std::size_t i = 0u; i != run_count; ++i)
+                    if (!runs[i].done()) heads.push({runs[i].front(), i});
+
+                std::uint64_t s2 {};
+                auto sorted = true;
+                std::optional<T> prev;
+
+                while (!heads.empty()) {
+                    const auto [x, i] = heads.top();
+                    heads.pop();
+
+                    if (prev && x < *prev) sorted = false;
+                    prev = x;
+                    s2 += mix64(Traits::hash(x));
+                    out.push(x);
+
+                    runs[i].pop();
+                    if (!runs[i].done()) heads.push({runs[i].front(), i});
+                }
+
+                out.finish();
+
+                fmt::print(console, "{:x}, {}; {}", s2,
+                           (s1 == s2 ? "same" : "DIFFERENT!"),
+                           (sorted ? "sorted." : "NOT SORTED!"));
+            });
+
+            print_peak_rss(timings, (buffer.size() + spare.size()) * sizeof(T),
+                           before);
+            return timings;
+        }
+    }
+
+#if defined(PMB_HAVE_TBB_CONTROL) && defined(PMB_HAVE_NUMA)
+    // Pins each thread that joins TBB's arena to the CPU for its slot, so
+    // the main thread (slot 0) and each worker keep to one CPU. Slots, and not
+    // the order threads first arrive, decide this, so a thread that leaves
+    // and rejoins keeps its CPU, and limiting threads uses the first CPUs.
+    class Pinner : public tbb::task_scheduler_observer {
+    public:
+        explicit Pinner(std::vector<unsigned> cpus) : cpus_{std::move(cpus)}
+        {
+            assert(!cpus_.empty());
+            observe(true);
+        }
+
+        Pinner(const Pinner&) = delete;
+        Pinner& operator=(const Pinner&) = delete;
+
+        ~Pinner() override { observe(false); }
+
+        void on_scheduler_entry(bool) override
+        {
+            const auto slot = tbb::this_task_arena::current_thread_index();
+            if (slot < 0) return;
+
+            const auto i = static_cast<std::size_t>(slot) % cpus_.size();
+            topology::pin_current_thread({cpus_[i]});
+        }
+
+    private:
+        std::vector<unsigned> cpus_;
+    };
+#endif
+
+    // Limits and pins the parallel algorithms' threads as the parameters
+    // say, and starts the pool if it's used, while this exists. Unless told
+    // not to, this also pins the calling thread to the first CPU.
+    class ThreadSetup {
+    public:
+        explicit ThreadSetup(const Parameters& params,
+                             const bool pin_caller = true)
+        {
+#ifdef PMB_HAVE_TBB_CONTROL
+            if (params.threads != 0u) {
+                limit_.emplace(tbb::global_control::max_allowed_parallelism,
+                               params.threads);
+            }
+
+            if (!params.pin_cpus.empty()) pinner_.emplace(params.pin_cpus);
+#endif
+#ifdef PMB_HAVE_NUMA
+            if (pin_caller && !params.pin_cpus.empty())
+                topology::pin_current_thread({params.pin_cpus.front()});
+#else
+            static_cast<void>(pin_caller);
+#endif
+
+            if (std::holds_alternative<pool_policy>(params.mode)) {
+                pool_.emplace(thread_count(params), params.pin_cpus);
+            }
+
+#ifdef _PSTL_PAR_BACKEND_TBB
+            heap::hidden = !std::holds_alternative<sequenced_policy>(
+                                params.mode)
+                            && !std::holds_alternative<pool_policy>(
+                                params.mode);
+#endif
+        }
+
+        ThreadSetup(const ThreadSetup&) = delete;
+        ThreadSetup& operator=(const ThreadSetup&) = delete;
+
+        ~ThreadSetup() { heap::hidden = hidden_; }
+
+    private:
+        bool hidden_ {heap::hidden}; // as it was before
+#ifdef PMB_HAVE_TBB_CONTROL
+        std::optional<tbb::global_control> limit_;
+        std::optional<Pinner> pinner_;
+#endif
+        std::optional<pool::Pool> pool_;
+    };
+
+    // Runs the warmups, then the trials, each freshly seeded with the seed.
+    // Returns the timings of each trial. Warmups are run but not recorded.
+    // Trials use storage if given, and otherwise each allocate their own.
+    template<typename T>
+    [[nodiscard]]
+    std::vector<TrialTimings> run_trials(const Parameters& params,
+                                         Array<T>* const storage)
+    {
+        const auto runs = params.warmups + params.trials;
+        std::vector<TrialTimings> results;
+        const ThreadSetup setup {params};
+
+        for (auto i = 0; i < runs; ++i) {
+            if (i >= params.warmups) {
+                if (runs > 1) {
+                    fmt::print(console, "{}Trial {} of {}:\n",
+                               (i == 0 ? "" : "\n"),
+                               i - params.warmups + 1, params.trials);
+                }
+            }
+            else {
+                fmt::print(console, "{}Warmup {} of {}:\n",
+                           (i == 0 ? "" : "\n"), i + 1, params.warmups);
+            }
+
+            Array<T> own {Allocator<T>{params}};
+            auto timings = (params.external
+                                ? external::test(params, own)
+                                : test(params, (storage ? *storage : own)));
+
+            if (i >= params.warmups) results.push_back(std::move(timings));
+        }
+
+        return results;
+    }
+
+    // The name of a stage, how much it accessed, and how long each trial took
+    // to run it, and what was counted during it.
+    struct StageSamples {
+        std::string name;
+        std::size_t elements;
+        std::uint64_t bytes;
+        std::vector<Duration> samples;
+        std::vector<Counts> counts;
+    };
+
+    // Regroups timings by stage, in the order stages first appear.
+    [[nodiscard]]
+    std::vector<StageSamples>
+    collate(const std::vector<TrialTimings>& trials)
+    {
+        std::vector<StageSamples> stages;
+
+        for (const auto& timings : trials) {
+            for (const auto& [name, elements, bytes, elapsed, counts]
+                    : timings) {
+                auto p = std::find_if(begin(stages), end(stages),
+                                      [&](const StageSamples& stage) {
+                    return stage.name == name;
+                });
+
+                if (p == end(stages)) {
+                    p = stages.insert(end(stages),
+                                      StageSamples{name, elements, bytes, {},
+                                                   {}});
+                }
+
+                p->samples.push_back(elapsed);
+                p->counts.push_back(counts);
+            }
+        }
+
+        return stages;
+    }
+
+    // Summary statistics of a stage's timings, in milliseconds.
+    struct StageStatistics {
+        double min, median, p90, p99, mean, stddev;
+    };
+
+    // Finds a percentile of sorted values, interpolating between closest ranks.
+    [[nodiscard]]
+    double percentile(const std::vector<double>& sorted, const double p)
+    {
+        assert(!sorted.empty());
+
+        const auto rank = p / 100.0 * static_cast<double>(sorted.size() - 1u);
+        const auto lower = static_cast<std::size_t>(rank);
+        const auto upper = std::min(lower + 1u, sorted.size() - 1u);
+        const auto weight = rank - static_cast<double>(lower);
+
+        return sorted[lower] + weight * (sorted[upper] - sorted[lower]);
+    }
+
+    [[nodiscard]]
+    StageStatistics summarize(const std::vector<Duration>& samples)
+    {
+        assert(!samples.empty());
+
+        std::vector<double> ms (samples.size());
+        std::transform(cbegin(samples), cend(samples), begin(ms),
+                       [](const Duration dt) { return dt / 1.0ms; });
+        std::sort(begin(ms), end(ms));
+
+        const auto count = static_cast<double>(ms.size());
+        const auto mean = std::accumulate(cbegin(ms), cend(ms), 0.0) / count;
+
+        const auto squares = std::accumulate(cbegin(ms), cend(ms), 0.0,
+                                             [mean](const double acc,
+                                                    const double x) {
+            return acc + (x - mean) * (x - mean);
+        });
+
+        const auto stddev = (ms.size() > 1u ? std::sqrt(squares / (count - 1.0))
+                                            : 0.0);
+
+        return {ms.front(), percentile(ms, 50.0), percentile(ms, 90.0),
+                percentile(ms, 99.0), mean, stddev};
+    }
+
+    // Prints a table of summary statistics for each stage over all trials.
+    void print_summary(const std::vector<TrialTimings>& trials)
+    {
+        static constexpr auto name_width = 20;
+
+        fmt::print(console, "\nSummary of {} trials"
+                            " (ms; throughput from the median):\n",
+                   trials.size());
+        fmt::print(console, "{:<{}}{:>10}{:>10}{:>10}{:>10}{:>10}{:>10}"
+                            "{:>10}{:>10}\n",
+                   "", name_width,
+                   "min", "median", "p90", "p99", "mean", "stddev",
+                   "GiB/s", "ns/elem");
+
+        for (const auto& stage : collate(trials)) {
+            const auto st = summarize(stage.samples);
+
+            fmt::print(console, "{:<{}}{:>10.2f}{:>10.2f}{:>10.2f}"
+                       "{:>10.2f}{:>10.2f}{:>10.2f}",
+                       stage.name, name_width,
+                       st.min, st.median, st.p90, st.p99, st.mean, st.stddev);
+
+            const auto median = std::chrono::duration_cast<Duration>(
+                                    st.median * 1.0ms);
+
+            if (const auto tp = throughput(stage.elements, stage.bytes,
+                                           median)) {
+                fmt::print(console, "{:>10.2f}{:>10.2f}",
+                           tp->gib_per_s, tp->ns_per_element);
+            }
+
+            fmt::print(console, "\n");
+        }
+    }
+
+    // Derives an instance's seed from the seed. Instance 0 uses the seed
+    // itself, so a failure it finds reproduces without --instances.
+    [[nodiscard]]
+    unsigned instance_seed(const unsigned seed, const int instance)
+    {
+        if (instance == 0) return seed;
+
+        std::seed_seq seq {seed, static_cast<unsigned>(instance)};
+        std::array<std::uint32_t, 1> out {};
+        seq.generate(begin(out), end(out));
+        return unsigned{out.front()};
+    }
+
+    // A file that's closed when this is destroyed.
+    using File = std::unique_ptr<std::FILE, decltype(&std::fclose)>;
+
+    // Makes a temporary file, removed when closed.
+    [[nodiscard]]
+    File make_scratch_file()
+    {
+        File file {std::tmpfile(), &std::fclose};
+        if (!file) die("can't make a scratch file for progress");
+        return file;
+    }
+
+    // Formats the local time, to say when something happened.
+    [[nodiscard]]
+    std::string format_localtime(const std::chrono::system_clock::time_point t)
+    {
+        using clock = std::chrono::system_clock;
+        return fmt::format("{:%F %T}", fmt::localtime(clock::to_time_t(t)));
+    }
+
+    // Prints each instance's sorting times, how much those vary between
+    // instances, and how fast all the instances went together.
+    void print_instances(const Parameters& params,
+                         const std::vector<std::vector<TrialTimings>>& rounds,
+                         const Duration elapsed)
+    {
+        fmt::print(console, "\nSorting by instance (ms):\n");
+        fmt::print(console, "{:>9}{:>12}{:>8}{:>10}{:>10}{:>10}{:>10}\n",
+                   "instance", "seed", "tests", "min", "median", "max",
+                   "GiB/s");
+
+        std::vector<double> medians;
+        auto together = 0.0;
+        auto tests = std::size_t{0};
+
+        for (std::size_t i = 0u; i != rounds.size(); ++i) {
+            const auto instance = static_cast<int>(i);
+            tests += rounds[i].size()
+                        + static_cast<std::size_t>(params.warmups);
+
+            for (const auto& stage : collate(rounds[i])) {
+                if (stage.name != "Sorting") continue;
+
+                const auto st = summarize(stage.samples);
+                const auto max = *std::max_element(cbegin(stage.samples),
+                                                   cend(stage.samples));
+                const auto tp = throughput(
+                        stage.elements, stage.bytes,
+                        std::chrono::duration_cast<Duration>(
+                            st.median * 1.0ms));
+
+                fmt::print(console, "{:>9}{:>12}{:>8}{:>10.2f}{:>10.2f}"
+                                    "{:>10.2f}{:>10.2f}\n",
+                           instance, instance_seed(params.seed, instance),
+                           stage.samples.size(), st.min, st.median,
+                           max / 1.0ms, (tp ? tp->gib_per_s : 0.0));
+
+                medians.push_back(st.median);
+                if (tp) together += tp->gib_per_s;
+            }
+        }
+
+        if (medians.empty()) return;
+
+        const auto count = static_cast<double>(medians.size());
+        const auto mean = std::accumulate(cbegin(medians), cend(medians), 0.0)
+                            / count;
+        const auto squares = std::accumulate(cbegin(medians), cend(medians),
+                                             0.0, [mean](const double acc,
+                                                         const double x) {
+            return acc + (x - mean) * (x - mean);
+        });
+        const auto stddev = (medians.size() > 1u
+                                ? std::sqrt(squares / (count - 1.0)) : 0.0);
+
+        fmt::print(console,
+                   "Between instances, median sorts average {:.2f} ms, with"
+                   " a standard deviation of {:.2f} ms ({:.1f}%).\n",
+                   mean, stddev, (mean > 0.0 ? stddev / mean * 100.0 : 0.0));
+
+        const auto seconds = elapsed / 1.0s;
+        if (seconds > 0.0) {
+            fmt::print(console,
+                       "Together, instances sorted at {:.2f} GiB/s, and went"
+                       " through whole tests at {:.1f} Melem/s.\n",
+                       together,
+                       static_cast<double>(tests)
+                        * static_cast<double>(params.length) / seconds / 1e6);
+        }
+    }
+
+    // Runs each instance's warmups, then its trials or, if it has a duration,
+    // as many tests as start before it passes, all instances at once, on
+    // threads of their own (pinned to pin_cpus[i % size], if pinning). Their
+    // progress goes to scratch files, but verification failures are printed
+    // as they happen. Returns the timings of every instance's recorded tests.
+    template<typename T>
+    [[nodiscard]]
+    std::vector<TrialTimings> run_instances(const Parameters& params)
+    {
+        using clock = std::chrono::steady_clock;
+
+        const auto out = console;
+        std::mutex out_mutex;
+
+        std::vector<File> logs;
+        for (auto i = 0; i != params.instances; ++i)
+            logs.push_back(make_scratch_file());
+
+        std::vector<std::vector<TrialTimings>> rounds (logs.size());
+        std::atomic<int> failures {0};
+
+        const auto start = clock::now();
+        const auto deadline = start + std::chrono::duration_cast<Duration>(
+                                        params.duration * 1.0s);
+
+        const auto run_instance = [&](const int instance) {
+            const auto index = static_cast<std::size_t>(instance);
+#ifdef PMB_HAVE_NUMA
+            if (const auto& cpus = params.pin_cpus; !cpus.empty())
+                topology::pin_current_thread({cpus[index % cpus.size()]});
+#endif
+            auto own = params;
+            own.seed = instance_seed(params.seed, instance);
+            console = logs[index].get();
+
+            for (auto round = 0; ; ++round) {
+                if (round >= params.warmups
+                        && (params.duration > 0.0
+                                ? clock::now() >= deadline
+                                : round == params.warmups + params.trials))
+                    break;
+
+                // Keep only this round's progress.
+                std::rewind(console);
+
+                Array<T> a {Allocator<T>{own}};
+                Verification verification {};
+                auto timings = test(own, a, &verification);
+
+                if (!verification.same || !verification.ordered) {
+                    ++failures;
+                    const std::lock_guard lock {out_mutex};
+                    fmt::print(out,
+                               "[{}] instance {} (seed {}), test {}:{}{}\n",
+                               format_localtime(
+                                    std::chrono::system_clock::now()),
+                               instance, own.seed, round + 1,
+                               (verification.same ? "" : " hash DIFFERENT!"),
+                               (verification.ordered ? "" : " NOT SORTED!"));
+                    std::fflush(out);
+                }
+
+                if (round >= params.warmups)
+                    rounds[index].push_back(std::move(timings));
+            }
+        };
+
+        const ThreadSetup setup {params, false};
+
+        fmt::print(console, "Running {} instances, showing any failures:\n",
+                   params.instances);
+
+        concurrent_stages = true;
+        std::vector<std::thread> threads;
+        for (auto i = 0; i != params.instances; ++i)
+            threads.emplace_back(run_instance, i);
+        for (auto& thread : threads) thread.join();
+        concurrent_stages = false;
+
+        const auto elapsed = clock::now() - start;
+        fmt::print(console, "Instances finished in {} ms, with {} failure{}.\n",
+                   elapsed / 1ms, failures.load(),
+                   (failures == 1 ? "" : "s"));
+
+        print_instances(params, rounds, elapsed);
+
+        std::vector<TrialTimings> results;
+        for (auto& instance : rounds) {
+            std::move(begin(instance), end(instance),
+                      std::back_inserter(results));
+        }
+        return results;
+    }
+
+    // Finds a stage of a test by its name.
+    [[nodiscard]]
+    const StageTiming* find_stage(const TrialTimings& timings,
+                                  const std::string_view name)
+    {
+        const auto p = std::find_if(cbegin(timings), cend(timings),
+                                    [name](const StageTiming& stage) {
+            return stage.name == name;
+        });
+        return (p == cend(timings) ? nullptr : &*p);
+    }
+
+    // Formats a duration as hours, minutes, and seconds, like 1:02:03.
+    [[nodiscard]]
+    std::string format_hms(const Duration dt)
+    {
+        const auto s = std::chrono::duration_cast<std::chrono::seconds>(dt)
+                        .count();
+        return fmt::format("{}:{:02}:{:02}", s / 3600, s / 60 % 60, s % 60);
+    }
+
+    // Finds the median of some values, which mustn't be empty.
+    [[nodiscard]]
+    double median_of(std::vector<double> values)
+    {
+        std::sort(begin(values), end(values));
+        return percentile(values, 50.0);
+    }
+
+    // Runs the warmups, then tests until the soak's time is up, all on one
+    // array and with the seed, so each should leave the same sorted array at
+    // the same addresses. The first test that passes verification records a
+    // checksum of each block, and later tests compare theirs with those, so
+    // a difference is found to a range of addresses. Each test gets a line,
+    // and a failed test's progress is printed in full. Returns the timings
+    // of the tests after the warmups.
+    template<typename T>
+    [[nodiscard]]
+    std::vector<TrialTimings> run_soak(const Parameters& params)
+    {
+        using clock = std::chrono::steady_clock;
+        static constexpr std::size_t shown_blocks {8u};
+        static constexpr std::size_t window {3u}; // tests at each end
+
+        const ThreadSetup setup {params};
+        const auto out = console;
+        const auto log = make_scratch_file();
+
+        Array<T> a {Allocator<T>{params}};
+        std::vector<std::uint64_t> reference;
+        std::vector<TrialTimings> results;
+        std::vector<double> rates; // sorting GiB/s of each recorded test
+        auto failures = 0;
+
+        const auto start = clock::now();
+        const auto deadline = start + std::chrono::duration_cast<Duration>(
+                                        params.soak * 1.0s);
+
+        fmt::print(console, "Soaking, with a line for each test:\n");
+
+        for (auto round = 0; round < params.warmups || clock::now() < deadline;
+                ++round) {
+            console = log.get();
+            std::rewind(console);
+
+            Verification verification {};
+            auto timings = test(params, a, &verification);
+            std::vector<std::size_t> differing;
+
+            const auto bytes = std::uint64_t{a.size()} * sizeof(T);
+            bench("Comparing blocks",
+                  report::recording(timings,
+                                    StageTiming{"Comparing blocks", a.size(),
+                                                bytes, {}, {}},
+                                    report::compact),
+                  [&] {
+                auto sums = block_checksums(params.mode, a);
+
+                if (!reference.empty()) {
+                    for (std::size_t i = 0u; i != sums.size(); ++i)
+                        if (sums[i] != reference[i]) differing.push_back(i);
+                    fmt::print(console, "{} of {} differ. ", differing.size(),
+                               sums.size());
+                }
+                else if (verification.same && verification.ordered) {
+                    fmt::print(console, "recorded {}. ", sums.size());
+                    reference = std::move(sums);
+                }
+            });
+
+            const auto logged = std::ftell(console);
+            console = out;
+
+            const auto recorded = (round >= params.warmups);
+            const auto failed = !verification.same || !verification.ordered
+                                || !differing.empty();
+
+            const auto sorting = find_stage(timings, "Sorting");
+            const auto tp = (sorting ? throughput(*sorting) : std::nullopt);
+            if (recorded && tp) rates.push_back(tp->gib_per_s);
+
+            fmt::print(console, "[{}] {} {} (+{}):",
+                       format_localtime(std::chrono::system_clock::now()),
+                       (recorded ? "test" : "warmup"),
+                       (recorded ? round - params.warmups : round) + 1,
+                       format_hms(clock::now() - start));
+
+            if (sorting) {
+                fmt::print(console, " sorted in {} ms",
+                           sorting->elapsed / 1ms);
+            }
+            if (recorded && tp) {
+                const auto baseline = median_of(
+                        {cbegin(rates),
+                         cbegin(rates) + gsl::narrow_cast<std::ptrdiff_t>(
+                                            std::min(window, rates.size()))});
+                fmt::print(console, ", {:.2f} GiB/s ({:+.1f}% from the start)",
+                           tp->gib_per_s,
+                           (tp->gib_per_s / baseline - 1.0) * 100.0);
+            }
+            fmt::print(console, "; {}\n", (failed ? "FAILED!" : "verified."));
+
+            if (failed) {
+                ++failures;
+
+                if (!verification.same) {
+                    fmt::print(console,
+                               "  The rehash differs from the hash.\n");
+                }
+                if (!verification.ordered)
+                    fmt::print(console, "  The array isn't in order.\n");
+
+                for (std::size_t i = 0u;
+                        i != std::min(differing.size(), shown_blocks); ++i) {
+                    const auto first = differing[i] * verify_block_length;
+                    const auto last = std::min(first + verify_block_length,
+                                               a.size());
+                    fmt::print(console,
+                               "  Block {} differs: elements {} to {}, at"
+                               " {} to {}.\n",
+                               differing[i], first, last - 1u,
+                               static_cast<const void*>(a.data() + first),
+                               static_cast<const void*>(a.data() + last));
+                }
+                if (differing.size() > shown_blocks) {
+                    fmt::print(console, "  ...and {} more blocks differ.\n",
+                               differing.size() - shown_blocks);
+                }
+
+                // Show what the test printed, indented.
+                std::string text (gsl::narrow_cast<std::size_t>(logged), '\0');
+                std::rewind(log.get());
+                text.resize(std::fread(text.data(), 1u, text.size(),
+                                       log.get()));
+
+                std::istringstream lines {text};
+                for (std::string line; std::getline(lines, line); )
+                    fmt::print(console, "    {}\n", line);
+            }
+
+            std::fflush(console);
+            if (recorded) results.push_back(std::move(timings));
+        }
+
+        fmt::print(console, "\nSoaked for {}: {} test{}, {} failed.\n",
+                   format_hms(clock::now() - start), results.size(),
+                   (results.size() == 1u ? "" : "s"), failures);
+
+        if (!rates.empty()) {
+            const auto n = gsl::narrow_cast<std::ptrdiff_t>(
+                                std::min(window, rates.size()));
+            const auto first = median_of({cbegin(rates), cbegin(rates) + n});
+            const auto last = median_of({cend(rates) - n, cend(rates)});
+            const auto [low, high] = std::minmax_element(cbegin(rates),
+                                                         cend(rates));
+
+            fmt::print(console,
+                       "Sorting went {:.2f} GiB/s at first and {:.2f} GiB/s"
+                       " at last ({:+.1f}%), ranging from {:.2f} to {:.2f}.\n",
+                       first, last, (last / first - 1.0) * 100.0, *low, *high);
+        }
+
+        return results;
+    }
+
+    // A queue that threads push to and wait to pop from, until it's closed.
+    // The stages of a pipeline pass buffers on to each other through these.
+    template<typename T>
+    class Channel {
+    public:
+        void push(T value)
+        {
+            {
+                const std::lock_guard lock {mutex_};
+                items_.push_back(std::move(value));
+            }
+            ready_.notify_one();
+        }
+
+        // Waits for an item. Returns nothing once closed and emptied.
+        [[nodiscard]]
+        std::optional<T> pop()
+        {
+            std::unique_lock lock {mutex_};
+            ready_.wait(lock, [this] { return closed_ || !items_.empty(); });
+            if (items_.empty()) return std::nullopt;
+
+            auto value = std::move(items_.front());
+            items_.pop_front();
+            return value;
+        }
+
+        void close()
+        {
+            {
+                const std::lock_guard lock {mutex_};
+                closed_ = true;
+            }
+            ready_.notify_all();
+        }
+
+    private:
+        std::mutex mutex_;
+        std::condition_variable ready_;
+        std::deque<T> items_;
+        bool closed_ {false};
+    };
+
+    // A trial on its way through a pipeline, in one of the buffers.
+    struct PipelineJob {
+        std::size_t buffer;
+        int round;
+        std::uint64_t hash;
+        TrialTimings timings;
+    };
+
+    // Runs the warmups and trials through a pipeline of buffers: a producer
+    // thread generates and hashes each trial's input, this thread sorts it,
+    // and a verifier thread rehashes and checks it, then hands the buffer
+    // back to the producer. So while one trial sorts, the next is generated
+    // and the last is verified, like a program sorting batches as they come.
+    // (Only the pool's workers are pinned, since the threads would otherwise
+    // inherit one CPU.) Each trial gets a line once it's verified. Returns
+    // the timings of the trials after the warmups. Their stages overlap, so
+    // what the sort sustained across them is printed after.
+    template<typename T>
+    [[nodiscard]]
+    std::vector<TrialTimings> run_pipeline(const Parameters& params)
+    {
+        using Traits = ElementTraits<T>;
+        using clock = std::chrono::steady_clock;
+
+        const auto runs = params.warmups + params.trials;
+        const auto bytes = std::uint64_t{params.length} * sizeof(T);
+        const auto quiet = [](const StageTiming&) { };
+
+        // Benchmarks a stage of a trial, recording but not printing it.
+        const auto stage = [&](TrialTimings& timings, std::string name,
+                               const int passes, auto&& action) {
+            return bench(report::recording(
+                            timings,
+                            StageTiming{std::move(name), params.length,
+                                        bytes * gsl::narrow_cast<unsigned>(
+                                                    passes),
+                                        {}, {}},
+                            quiet),
+                         std::forward<decltype(action)>(action));
+        };
+
+        const ThreadSetup setup {params, false};
+
+        std::vector<Array<T>> arrays;
+        fmt::print(console, "Allocating/zeroing {} buffers... ",
+                   params.pipeline);
+        bench([](const Duration dt) {
+            fmt::print(console, "Done. ({} ms)\n", dt / 1ms);
+        }, [&] {
+            for (auto i = 0; i != params.pipeline; ++i) {
+                arrays.emplace_back(Allocator<T>{params});
+                arrays.back().resize(params.length);
+            }
+        });
+
+        Channel<std::size_t> free;
+        Channel<PipelineJob> generated, sorted;
+        for (std::size_t i = 0u; i != arrays.size(); ++i) free.push(i);
+
+        const auto produce = [&] {
+            for (auto round = 0; round != runs; ++round) {
+                auto buffer = free.pop();
+                assert(buffer);
+                auto& a = arrays[*buffer];
+                TrialTimings timings;
+
+                stage(timings, "Generating", 1, [&] {
+                    if (params.blockwise_generation) {
+                        generate_blockwise(params.mode, params.distribution,
+                                           a, params.seed);
+                    }
+                    else {
+                        typename Traits::Engine gen {params.seed};
+                        generate_range(params.distribution, a, 0u, a.size(),
+                                       gen);
+                    }
+                });
+
+                const auto hash = stage(timings, "Hashing", 1, [&] {
+                    return checksum(params.mode, a);
+                });
+
+                generated.push({*buffer, round, hash, std::move(timings)});
+            }
+            generated.close();
+        };
+
+        std::vector<TrialTimings> results;
+        auto failures = 0;
+
+        const auto verify = [&] {
+            while (auto job = sorted.pop()) {
+                const auto& a = arrays[job->buffer];
+
+                const auto same = stage(job->timings, "Rehashing", 1, [&] {
+                    return checksum(params.mode, a) == job->hash;
+                });
+                const auto order = stage(job->timings, "Checking", 1, [&] {
+                    return check_order(params, a);
+                });
+
+                const auto ms = [&job](const std::string_view name) {
+                    const auto p = find_stage(job->timings, name);
+                    return (p ? p->elapsed / 1ms : Duration::rep{});
+                };
+
+                const auto recorded = (job->round >= params.warmups);
+                fmt::print(console,
+                           "{} {} of {}: generated in {} ms, sorted in {} ms,"
+                           " verified in {} ms; {:x}, {} {}\n",
+                           (recorded ? "Trial" : "Warmup"),
+                           (recorded ? job->round - params.warmups
+                                     : job->round) + 1,
+                           (recorded ? params.trials : params.warmups),
+                           ms("Generating") + ms("Hashing"), ms("Sorting"),
+                           ms("Rehashing") + ms("Checking"), job->hash,
+                           (same ? "same," : "DIFFERENT!"),
+                           order.description);
+                std::fflush(console);
+
+                if (!same || !order.ok) ++failures;
+                free.push(job->buffer);
+                if (recorded) results.push_back(std::move(job->timings));
+            }
+        };
+
+        fmt::print(console, "Pipelining {} tests, with a line for each:\n",
+                   runs);
+
+        concurrent_stages = true;
+        std::thread producer {produce}, verifier {verify};
+
+        // Since the first recorded sort: when it started, time spent sorting,
+        // and time spent waiting for input.
+        std::optional<clock::time_point> start;
+        Duration busy {}, starved {};
+        auto sorts = 0;
+
+        for (auto waited = clock::now(); auto job = generated.pop();
+                waited = clock::now()) {
+            const auto recorded = (job->round >= params.warmups);
+            const auto ti = clock::now();
+            if (recorded && start) starved += ti - waited;
+            if (recorded && !start) start = ti;
+
+            auto& a = arrays[job->buffer];
+            for (auto i = 1; i <= params.inplace_reps; ++i) {
+                const auto name = (i == 1 ? std::string{"Sorting"}
+                                          : fmt::format("Sorting #{}", i));
+                static_cast<void>(stage(job->timings, name, 2, [&] {
+                    return sort(params, a);
+                }));
+            }
+
+            if (recorded) {
+                busy += clock::now() - ti;
+                sorts += params.inplace_reps;
+            }
+            sorted.push(std::move(*job));
+        }
+
+        const auto finish = clock::now();
+        sorted.close();
+        producer.join();
+        verifier.join();
+        concurrent_stages = false;
+
+        const auto span = finish - *start;
+        fmt::print(console,
+                   "\nPipelined {} trial{} through {} buffers in {} ms, with"
+                   " {} failure{}.\n",
+                   params.trials, (params.trials == 1 ? "" : "s"),
+                   params.pipeline, span / 1ms, failures,
+                   (failures == 1 ? "" : "s"));
+
+        const auto count = gsl::narrow_cast<unsigned>(sorts);
+        if (const auto tp = throughput(params.length * count,
+                                       bytes * 2u * count, span)) {
+            fmt::print(console,
+                       "Sorting sustained {:.2f} GiB/s ({:.1f} Melem/s), busy"
+                       " {:.0f}% of the time and waiting {} ms for input.\n",
+                       tp->gib_per_s, tp->elements_per_s / 1e6,
+                       busy / 1.0ms / (span / 1.0ms) * 100.0,
+                       starved / 1ms);
+        }
+
+        return results;
+    }
+
+    // The parameters of a run of some trials, and the timings of each trial.
+    struct Run {
+        Parameters params;
+        std::vector<TrialTimings> trials;
+    };
+
+    // Runs trials and, if there are several, summarizes them.
+    template<typename T>
+    [[nodiscard]]
+    Run run(const Parameters& params, Array<T>* const storage)
+    {
+        auto trials = (params.soak > 0.0 ? run_soak<T>(params)
+                       : params.pipeline > 0 ? run_pipeline<T>(params)
+                       : params.instances > 1 ? run_instances<T>(params)
+                       : run_trials(params, storage));
+        if (trials.size() > 1u) print_summary(trials);
+        return {params, std::move(trials)};
+    }
+
+    // Finds the median time of a stage in a run, by its name.
+    [[nodiscard]]
+    std::optional<double> median_ms(const Run& run, const std::string_view name)
+    {
+        for (const auto& stage : collate(run.trials))
+            if (stage.name == name) return summarize(stage.samples).median;
+
+        return std::nullopt;
+    }
+
+    // Prints how the sort's speed scales with threads, against seq.
+    void print_scaling(const std::vector<Run>& runs)
+    {
+        assert(!runs.empty());
+
+        const auto baseline = median_ms(runs.front(), "Sorting");
+        if (!baseline) return;
+
+        fmt::print(console, "\nScaling of sorting (median ms) against seq:\n");
+        fmt::print(console, "{:>8}{:>12}{:>10}{:>12}\n",
+                   "threads", "ms", "speedup", "efficiency");
+        fmt::print(console, "{:>8}{:>12.2f}{:>10.2f}\n", "seq", *baseline, 1.0);
+
+        for (auto p = std::next(cbegin(runs)); p != cend(runs); ++p) {
+            const auto ms = median_ms(*p, "Sorting");
+            if (!ms) continue;
+
+            const auto speedup = *baseline / *ms;
+            fmt::print(console, "{:>8}{:>12.2f}{:>10.2f}{:>11.1f}%\n",
+                       p->params.threads, *ms, speedup,
+                       speedup / p->params.threads * 100.0);
+        }
+    }
+
+    // Prints how the sort's time per element changes with the length.
+    void print_length_scaling(const std::vector<Run>& runs)
+    {
+        assert(!runs.empty());
+        const auto element_bytes = element_size(runs.front().params
+                                                            .element_type);
+
+        fmt::print(console, "\nSorting (median) by length:\n");
+        fmt::print(console, "{:>14}{:>14}{:>12}{:>10}{:>10}\n",
+                   "length", "KiB", "ms", "ns/elem", "GiB/s");
+
+        for (const auto& run : runs) {
+            const auto ms = median_ms(run, "Sorting");
+            if (!ms) continue;
+
+            const auto tp = throughput(
+                run.params.length,
+                std::uint64_t{run.params.length} * element_bytes * 2u,
+                std::chrono::duration_cast<Duration>(*ms * 1.0ms));
+
+            fmt::print(console, "{:>14}{:>14.1f}{:>12.3f}",
+                       run.params.length,
+                       static_cast<double>(run.params.length * element_bytes)
+                            / 1024.0,
+                       *ms);
+
+            if (tp) {
+                fmt::print(console, "{:>10.2f}{:>10.2f}\n",
+                           tp->ns_per_element, tp->gib_per_s);
+            }
+            else fmt::print(console, "{:>10}{:>10}\n", "-", "-");
+        }
+
+        if (!runs.front().params.latency) return;
+
+        fmt::print(console, "\nPointer chasing (median) by length:\n");
+        fmt::print(console, "{:>14}{:>14}{:>12}{:>10}\n",
+                   "length", "KiB", "ms", "ns/load");
+
+        for (const auto& run : runs) {
+            const auto ms = median_ms(run, "Chasing pointers");
+            if (!ms) continue;
+
+            fmt::print(console, "{:>14}{:>14.1f}{:>12.3f}{:>10.2f}\n",
+                       run.params.length,
+                       static_cast<double>(run.params.length * element_bytes)
+                            / 1024.0,
+                       *ms, *ms * 1e6 / static_cast<double>(chase_loads));
+        }
+    }
+
+    // Runs trials once or, if sweeping thread counts, once with seq as a
+    // baseline and once for each thread count in the requested mode.
+    template<typename T>
+    [[nodiscard]]
+    std::vector<Run> run_thread_sweep(const Parameters& params,
+                                      Array<T>* const storage)
+    {
+        if (params.thread_sweep.empty()) return {run(params, storage)};
+
+        std::vector<Run> runs;
+
+        auto baseline = params;
+        baseline.mode = seq;
+        baseline.thread_sweep.clear();
+        fmt::print(console, "Baseline, in {}:\n", baseline.mode);
+        runs.push_back(run(baseline, storage));
+
+        for (const auto threads : params.thread_sweep) {
+            auto limited = params;
+            limited.threads = threads;
+            limited.thread_sweep.clear();
+            fmt::print(console, "\nWith {} thread{}:\n",
+                       threads, (threads == 1u ? "" : "s"));
+            runs.push_back(run(limited, storage));
+        }
+
+        print_scaling(runs);
+        return runs;
+    }
+
+    // Runs all trials, for each length if sweeping lengths. A length sweep
+    // reuses one array, with capacity reserved up front for the largest.
+    [[nodiscard]]
+    std::vector<Run> run_sweep(const Parameters& params)
+    {
+        return visit([&](auto tag) -> std::vector<Run> {
+            using T = typename decltype(tag)::type;
+
+            // Types without kernels aren't built, so configure() rejects them.
+            if constexpr (!has_sort_kernels<T>) {
+                NOT_REACHED();
+            }
+            else {
+                if (params.length_sweep.empty())
+                    return run_thread_sweep<T>(params, nullptr);
+
+                Array<T> storage {Allocator<T>{params}};
+                storage.reserve(params.length);
+
+                std::vector<Run> runs;
+                for (const auto length : params.length_sweep) {
+                    auto sized = params;
+                    sized.length = length;
+                    sized.length_sweep.clear();
+                    fmt::print(console, "{}Length {}:\n",
+                               (runs.empty() ? "" : "\n"), length);
+                    runs.push_back(run(sized, &storage));
+                }
+
+                print_length_scaling(runs);
+                return runs;
+            }
+        }, params.element_type);
+    }
+
+    // Information to tell apart results from different machines and builds.
+    struct HostInfo {
+        std::string name;
+        std::string os;
+        unsigned cpus;
+        std::string compiler;
+        topology::Topology topology;
+    };
+
+    [[nodiscard]]
+    HostInfo describe_host()
+    {
+        HostInfo host {};
+
+#ifdef PMB_HAVE_UNAME
+        std::array<char, 256> name {};
+        if (gethostname(name.data(), name.size() - 1u) == 0)
+            host.name = name.data();
+
+        if (utsname uts {}; uname(&uts) == 0)
+            host.os = fmt::format("{} {} {}", uts.sysname, uts.release,
+                                  uts.machine);
+#else
+        if (const auto name = std::getenv("COMPUTERNAME")) host.name = name;
+#endif
+
+#if defined(_WIN32)
+        host.os = "Windows";
+#endif
+
+        host.cpus = std::thread::hardware_concurrency();
+        host.topology = topology::detect();
+
+#if defined(__clang__) || defined(__GNUC__)
+        host.compiler = __VERSION__;
+#elif defined(_MSC_VER)
+        host.compiler = fmt::format("MSVC {}", _MSC_FULL_VER);
+#endif
+
+        return host;
+    }
+
+    [[nodiscard]]
+    std::string json_quote(const std::string_view s)
+    {
+        std::string ret {"\""};
+
+        for (const auto c : s) {
+            switch (c) {
+            case '"':  ret += "\\\""; break;
+            case '\\': ret += "\\\\"; break;
+            case '\n': ret += "\\n"; break;
+            case '\t': ret += "\\t"; break;
+            default:
+                if (std::iscntrl(static_cast<unsigned char>(c))) {
+                    ret += fmt::format("\\u{:04x}",
+                                       static_cast<unsigned char>(c));
+                }
+                else ret += c;
+            }
+        }
+
+        return ret += '"';
+    }
+
+    [[nodiscard]]
+    std::string csv_quote(const std::string_view s)
+    {
+        if (s.find_first_of(",\"\r\n") == std::string_view::npos)
+            return std::string{s};
+
+        std::string ret {"\""};
+        for (const auto c : s) {
+            if (c == '"') ret += '"';
+            ret += c;
+        }
+        return ret += '"';
+    }
+
+    // A named value in machine-readable results. It is null if it is absent.
+    struct Field {
+        std::string_view name;
+        std::optional<std::string> value;
+        bool is_string;
+    };
+
+    template<typename T>
+    [[nodiscard]]
+    Field number_field(const std::string_view name, const T& value)
+    {
+        return {name, fmt::format("{}", value), false};
+    }
+
+    [[nodiscard]]
+    Field string_field(const std::string_view name,
+                       const std::string_view value)
+    {
+        return {name, std::string{value}, true};
+    }
+
+    [[nodiscard]]
+    Field null_field(const std::string_view name)
+    {
+        return {name, std::nullopt, false};
+    }
+
+    [[nodiscard]]
+    std::string json_value(const Field& field)
+    {
+        if (!field.value) return "null";
+        return (field.is_string ? json_quote(*field.value) : *field.value);
+    }
+
+    [[nodiscard]]
+    std::string csv_value(const Field& field)
+    {
+        if (!field.value) return "";
+        return (field.is_string ? csv_quote(*field.value) : *field.value);
+    }
+
+    // Joins numbers with spaces.
+    [[nodiscard]]
+    std::string join_numbers(const std::vector<unsigned>& numbers)
+    {
+        std::string ret;
+        for (const auto n : numbers)
+            ret += fmt::format("{}{}", (ret.empty() ? "" : " "), n);
+        return ret;
+    }
+
+    // Joins perturbation levels (fractions) with spaces.
+    [[nodiscard]]
+    std::string join_levels(const std::vector<double>& levels)
+    {
+        std::string ret;
+        for (const auto level : levels)
+            ret += fmt::format("{}{:g}", (ret.empty() ? "" : " "), level);
+        return ret;
+    }
+
+    // Joins the names of kernels with spaces.
+    [[nodiscard]]
+    std::string join_kernel_names(const std::vector<Kernel>& kernels)
+    {
+        std::string ret;
+        for (const auto& kernel : kernels)
+            ret += fmt::format("{}{}", (ret.empty() ? "" : " "),
+                               kernel_name(kernel));
+        return ret;
+    }
+
+    [[nodiscard]]
+    std::vector<Field> host_fields(const HostInfo& host)
+    {
+        const auto& topo = host.topology;
+        const auto known = !topo.cpus.empty();
+
+        return {string_field("host", host.name),
+                string_field("os", host.os),
+                number_field("cpus", host.cpus),
+                (known ? number_field("sockets", topology::package_count(topo))
+                       : null_field("sockets")),
+                (known ? number_field("cores", topology::core_count(topo))
+                       : null_field("cores")),
+                (known ? number_field("numa_nodes", topo.nodes.size())
+                       : null_field("numa_nodes")),
+                string_field("caches", topology::describe_caches(topo)),
+                string_field("compiler", host.compiler)};
+    }
+
+    [[nodiscard]]
+    std::vector<Field> parameter_fields(const Parameters& params)
+    {
+        return {number_field("length", params.length),
+                string_field("element_type", element_name(params.element_type)),
+                number_field("element_bytes",
+                             element_size(params.element_type)),
+                number_field("seed", params.seed),
+                string_field("distribution",
+                             distribution_name(params.distribution)),
+                string_field("algorithm", algorithm_name(params.algorithm)),
+                (params.buckets == 0u ? null_field("buckets")
+                                      : number_field("buckets",
+                                                     params.buckets)),
+                (params.bucket_bytes == 0u ? null_field("bucket_bytes")
+                                           : number_field("bucket_bytes",
+                                                          params.bucket_bytes)),
+                string_field("mode", option_name(params.mode)),
+                string_field("alloc", alloc_name(params.alloc)),
+                (params.advice ? string_field("madvise",
+                                              advice_name(*params.advice))
+                               : null_field("madvise")),
+                (params.input ? string_field("input", params.input->string())
+                              : null_field("input")),
+                (params.output ? string_field("output",
+                                              params.output->string())
+                               : null_field("output")),
+                (params.numa ? string_field("numa", numa_name(*params.numa))
+                             : null_field("numa")),
+                (params.pin ? string_field("pin", pin_name(*params.pin))
+                            : null_field("pin")),
+                (params.pin ? string_field("pin_cpus",
+                                           join_numbers(params.pin_cpus))
+                            : null_field("pin_cpus")),
+                (params.threads == 0u ? null_field("threads")
+                                      : number_field("threads",
+                                                     params.threads)),
+                number_field("blockwise_generation",
+                             params.blockwise_generation),
+                number_field("inplace_reps", params.inplace_reps),
+                number_field("trials", params.trials),
+                number_field("warmups", params.warmups),
+                number_field("instances", params.instances),
+                (params.duration > 0.0 ? number_field("duration_s",
+                                                      params.duration)
+                                       : null_field("duration_s")),
+                (params.soak > 0.0 ? number_field("soak_s", params.soak)
+                                   : null_field("soak_s")),
+                (params.pipeline > 0 ? number_field("pipeline_buffers",
+                                                    params.pipeline)
+                                     : null_field("pipeline_buffers")),
+                (params.sample ? string_field("sample_file",
+                                              params.sample->string())
+                               : null_field("sample_file")),
+                (params.sample ? number_field("sample_interval_ms",
+                                              params.sample_interval.count())
+                               : null_field("sample_interval_ms")),
+                (params.perturbation ? string_field("perturbation",
+                                                    perturbation_name(
+                                                        *params.perturbation))
+                                     : null_field("perturbation")),
+                (params.perturbation ? string_field("perturb_levels",
+                                                    join_levels(
+                                                        params.perturb_levels))
+                                     : null_field("perturb_levels")),
+                number_field("counters", params.counters),
+                (params.kernels.empty() ? null_field("kernels")
+                                        : string_field("kernels",
+                                                       join_kernel_names(
+                                                           params.kernels))),
+                (params.latency ? string_field("latency",
+                                               latency_name(*params.latency))
+                                : null_field("latency")),
+                (params.external ? string_field("external",
+                                                params.external->string())
+                                 : null_field("external")),
+                (params.external ? number_field("run_length",
+                                                params.run_length)
+                                 : null_field("run_length"))};
+    }
+
+    // Computes throughput from the median of a stage's times.
+    [[nodiscard]]
+    std::optional<Throughput> median_throughput(const StageSamples& stage,
+                                                const StageStatistics& st)
+    {
+        const auto median = std::chrono::duration_cast<Duration>(
+                                st.median * 1.0ms);
+
+        return throughput(stage.elements, stage.bytes, median);
+    }
+
+    [[nodiscard]]
+    std::vector<Field> throughput_fields(const std::optional<Throughput>& tp)
+    {
+        if (!tp) {
+            return {null_field("gib_per_s"), null_field("elements_per_s"),
+                    null_field("ns_per_element")};
+        }
+
+        return {number_field("gib_per_s", fmt::format("{:.6g}", tp->gib_per_s)),
+                number_field("elements_per_s",
+                             fmt::format("{:.6g}", tp->elements_per_s)),
+                number_field("ns_per_element",
+                             fmt::format("{:.6g}", tp->ns_per_element))};
+    }
+
+    // A kind of count, and how to get it from what was counted.
+    struct CountColumn {
+        std::string_view name;
+        std::optional<std::uint64_t> (*get)(const Counts&);
+    };
+
+    template<std::uint64_t OsCounts::* Member>
+    [[nodiscard]]
+    std::optional<std::uint64_t> os_count(const Counts& counts)
+    {
+        if (!counts.os) return std::nullopt;
+        return (*counts.os).*Member;
+    }
+
+    template<std::optional<std::uint64_t> HwCounts::* Member>
+    [[nodiscard]]
+    std::optional<std::uint64_t> hw_count(const Counts& counts)
+    {
+        if (!counts.hw) return std::nullopt;
+        return (*counts.hw).*Member;
+    }
+
+    template<std::uint64_t HeapCounts::* Member>
+    [[nodiscard]]
+    std::optional<std::uint64_t> heap_count(const Counts& counts)
+    {
+        if (!counts.heap) return std::nullopt;
+        return (*counts.heap).*Member;
+    }
+
+    template<std::uint64_t PoolCounts::* Member>
+    [[nodiscard]]
+    std::optional<std::uint64_t> pool_count(const Counts& counts)
+    {
+        if (!counts.pool) return std::nullopt;
+        return (*counts.pool).*Member;
+    }
+
+    [[nodiscard]]
+    std::optional<std::uint64_t> peak_rss_count(const Counts& counts)
+    {
+        return counts.peak_rss;
+    }
+
+    constexpr std::array<CountColumn, 14> count_columns {{
+        {"minor_faults", os_count<&OsCounts::minor_faults>},
+        {"major_faults", os_count<&OsCounts::major_faults>},
+        {"context_switches", os_count<&OsCounts::context_switches>},
+        {"cycles", hw_count<&HwCounts::cycles>},
+        {"instructions", hw_count<&HwCounts::instructions>},
+        {"llc_misses", hw_count<&HwCounts::llc_misses>},
+        {"dtlb_misses", hw_count<&HwCounts::dtlb_misses>},
+        {"branch_misses", hw_count<&HwCounts::branch_misses>},
+        {"heap_allocated_bytes", heap_count<&HeapCounts::heap_allocated>},
+        {"heap_allocations", heap_count<&HeapCounts::heap_allocations>},
+        {"heap_peak_bytes", heap_count<&HeapCounts::heap_peak>},
+        {"peak_rss_bytes", peak_rss_count},
+        {"pool_tasks_forked", pool_count<&PoolCounts::forked>},
+        {"pool_tasks_stolen", pool_count<&PoolCounts::stolen>}
+    }};
+
+    [[nodiscard]]
+    std::vector<Field> count_fields(const Counts& counts)
+    {
+        std::vector<Field> fields;
+
+        for (const auto& column : count_columns) {
+            const auto n = column.get(counts);
+            fields.push_back(n ? number_field(column.name, *n)
+                               : null_field(column.name));
+        }
+
+        return fields;
+    }
+
+    // Formats each trial's count of each kind as a JSON array, or null if any
+    // trial's count of that kind is unknown.
+    [[nodiscard]]
+    std::vector<Field> count_samples_fields(const StageSamples& stage)
+    {
+        std::vector<Field> fields;
+
+        for (const auto& column : count_columns) {
+            std::string samples;
+            auto known = true;
+
+            for (const auto& counts : stage.counts) {
+                const auto n = column.get(counts);
+                if (!n) {
+                    known = false;
+                    break;
+                }
+                samples += fmt::format("{}{}", (samples.empty() ? "" : ", "),
+                                       *n);
+            }
+
+            fields.push_back(known ? number_field(column.name,
+                                                  "[" + samples + "]")
+                                   : null_field(column.name));
+        }
+
+        return fields;
+    }
+
+    // Writes fields as the members of a JSON object, one per line.
+    void write_json_members(std::FILE* const out,
+                            const std::vector<Field>& fields, const int indent)
+    {
+        for (auto p = cbegin(fields); p != cend(fields); ++p) {
+            fmt::print(out, "{:{}}{}: {}{}\n", "", indent,
+                       json_quote(p->name), json_value(*p),
+                       (std::next(p) == cend(fields) ? "" : ","));
+        }
+    }
+
+    // Writes host information, and the parameters, per-stage timings, and
+    // derived statistics and throughput of each run, as a JSON object.
+    void write_json(std::FILE* const out, const HostInfo& host,
+                    const std::vector<Run>& runs)
+    {
+        fmt::print(out, "{{\n");
+
+        fmt::print(out, "  \"host\": {{\n");
+        write_json_members(out, host_fields(host), 4);
+        fmt::print(out, "  }},\n");
+
+        fmt::print(out, "  \"runs\": [");
+
+        for (auto run = cbegin(runs); run != cend(runs); ++run) {
+            fmt::print(out, "{}\n    {{\n", (run == cbegin(runs) ? "" : ","));
+
+            fmt::print(out, "      \"parameters\": {{\n");
+            write_json_members(out, parameter_fields(run->params), 8);
+            fmt::print(out, "      }},\n");
+
+            fmt::print(out, "      \"stages\": [");
+            const auto stages = collate(run->trials);
+
+            for (auto stage = cbegin(stages); stage != cend(stages); ++stage) {
+                const auto st = summarize(stage->samples);
+
+                fmt::print(out, "{}\n        {{\n",
+                           (stage == cbegin(stages) ? "" : ","));
+
+                std::string samples;
+                for (const auto dt : stage->samples) {
+                    samples += fmt::format("{}{:.3f}",
+                                           (samples.empty() ? "" : ", "),
+                                           dt / 1.0ms);
+                }
+
+                auto fields = std::vector<Field>{
+                    string_field("name", stage->name),
+                    number_field("elements", stage->elements),
+                    number_field("bytes", stage->bytes),
+                    number_field("samples_ms", "[" + samples + "]"),
+                    number_field("min_ms", fmt::format("{:.3f}", st.min)),
+                    number_field("median_ms", fmt::format("{:.3f}", st.median)),
+                    number_field("p90_ms", fmt::format("{:.3f}", st.p90)),
+                    number_field("p99_ms", fmt::format("{:.3f}", st.p99)),
+                    number_field("mean_ms", fmt::format("{:.3f}", st.mean)),
+                    number_field("stddev_ms", fmt::format("{:.3f}", st.stddev))
+                };
+
+                const auto count_fields = count_samples_fields(*stage);
+                fields.insert(end(fields), cbegin(count_fields),
+                              cend(count_fields));
+
+                const auto tp_fields = throughput_fields(
+                                        median_throughput(*stage, st));
+                fields.insert(end(fields), cbegin(tp_fields), cend(tp_fields));
+
+                write_json_members(out, fields, 10);
+                fmt::print(out, "        }}");
+            }
+
+            fmt::print(out, "\n      ]\n    }}");
+        }
+
+        fmt::print(out, "\n  ]\n}}\n");
+    }
+
+    // Writes a CSV table with a record for each stage of each trial of each
+    // run. Each record repeats the host and parameters, so it stands alone.
+    void write_csv(std::FILE* const out, const HostInfo& host,
+                   const std::vector<Run>& runs)
+    {
+        if (runs.empty()) return;
 
-        switch (got_seq + got_par + got_par_unseq) {
-        case 0u:
-            return par;
+        const auto join = [](const std::vector<Field>& fields,
+                             const auto& project) {
+            std::string ret;
+            for (const auto& field : fields) {
+                if (!ret.empty()) ret += ',';
+                ret += project(field);
+            }
+            return ret;
+        };
 
-        case 1u:
-            if (got_seq) return seq;
-            if (got_par) return par;
-            if (got_par_unseq) return par_unseq;
-            NOT_REACHED();
+        const auto name = [](const Field& field) {
+            return std::string{field.name};
+        };
 
-        default:
-            die("at most one of (--seq, --par, --par-unseq) is accepted");
+        const auto host_prefix = join(host_fields(host), csv_value);
+
+        fmt::print(out, "{},{},trial,stage,elements,bytes,ms,{},{}\n",
+                   join(host_fields(host), name),
+                   join(parameter_fields(runs.front().params), name),
+                   join(throughput_fields(std::nullopt), name),
+                   join(count_fields(Counts{}), name));
+
+        for (const auto& run : runs) {
+            const auto prefix = host_prefix + ","
+                                + join(parameter_fields(run.params), csv_value);
+
+            for (std::size_t i = 0u; i != run.trials.size(); ++i) {
+                for (const auto& stage : run.trials[i]) {
+                    fmt::print(out, "{},{},{},{},{},{:.3f},{},{}\n",
+                               prefix, i + 1u, csv_quote(stage.name),
+                               stage.elements, stage.bytes,
+                               stage.elapsed / 1.0ms,
+                               join(throughput_fields(throughput(stage)),
+                                    csv_value),
+                               join(count_fields(stage.counts), csv_value));
+                }
+            }
+        }
+    }
+
+    // Writes machine-readable results to stdout, if they were requested.
+    void write_results(const OutputFormat format, const std::vector<Run>& runs)
+    {
+        switch (format) {
+        case OutputFormat::text:
+            return;
+
+        case OutputFormat::json:
+            write_json(stdout, describe_host(), runs);
+            return;
+
+        case OutputFormat::csv:
+            write_csv(stdout, describe_host(), runs);
+            return;
         }
+
+        NOT_REACHED();
     }
 
+    // The exit status when a comparison finds a stage that regressed.
+    constexpr int regressed_exit_status {2};
+
+    // Opens a file for a baseline or samples. This is done before the run, so
+    // a bad path doesn't waste it.
     [[nodiscard]]
-    Parameters extract_operating_parameters(const po::variables_map& vm)
+    File open_for_writing(const std::filesystem::path& path)
     {
-        Parameters params {};
+        File file {std::fopen(path.string().c_str(), "w"), &std::fclose};
+        if (!file) die(fmt::format("can't write {}", path.string()));
+        return file;
+    }
 
-        params.length = extract_length(vm);
-        std::tie(params.seed, params.seed_origin) = obtain_seed_info(vm);
-        params.mode = extract_dynamic_execution_policy(vm);
-        params.inplace_reps = (vm.count("twice") ? 2 : 1);
-        params.show_start_time = vm.count("time");
+    // Saves results as a baseline for a later --compare, in the JSON format.
+    void save_baseline(File file, const std::filesystem::path& path,
+                       const std::vector<Run>& runs)
+    {
+        write_json(file.get(), describe_host(), runs);
+        if (std::fclose(file.release()) != 0)
+            die(fmt::format("can't write {}", path.string()));
+        fmt::print(console, "Saved the baseline to {}.\n", path.string());
+    }
 
-        return params;
+    // Names and values, as written in JSON (without quotes), in order.
+    using SavedFields = std::vector<std::pair<std::string, std::string>>;
+
+    // A stage of a saved run: its name, and each trial's time.
+    struct SavedStage {
+        std::string name;
+        std::vector<double> samples_ms;
+    };
+
+    struct SavedRun {
+        SavedFields parameters;
+        std::vector<SavedStage> stages;
+    };
+
+    struct Baseline {
+        SavedFields host;
+        std::vector<SavedRun> runs;
+    };
+
+    [[nodiscard]]
+    SavedFields read_fields(const pt::ptree& tree)
+    {
+        SavedFields fields;
+        for (const auto& [name, child] : tree)
+            fields.emplace_back(name, child.data());
+        return fields;
     }
 
+    // Reads a baseline that --save-baseline wrote.
     [[nodiscard]]
-    Parameters
-    configure(const int argc, const gsl::not_null<const char* const*> argv)
+    Baseline load_baseline(const std::filesystem::path& path)
     {
-        // Set the program name for error messages to the Unix-style basename.
-        assert(argc > 0);
-        program_name = std::filesystem::path{*argv}.filename().string();
+        Baseline baseline;
 
-        // Fetch operating parameters from command-line arguments and defaults.
-        return extract_operating_parameters(parse_cmdline_args(argc, argv));
+        try {
+            pt::ptree tree;
+            pt::read_json(path.string(), tree);
+
+            baseline.host = read_fields(tree.get_child("host"));
+
+            for (const auto& [_, run] : tree.get_child("runs")) {
+                auto& saved = baseline.runs.emplace_back();
+                saved.parameters = read_fields(run.get_child("parameters"));
+
+                for (const auto& [__, stage] : run.get_child("stages")) {
+                    auto& samples = saved.stages.emplace_back(
+                            SavedStage{stage.get<std::string>("name"), {}})
+                                .samples_ms;
+                    for (const auto& [___, sample]
+                            : stage.get_child("samples_ms"))
+                        samples.push_back(sample.get_value<double>());
+                }
+            }
+        }
+        catch (const pt::ptree_error& e) {
+            die(fmt::format("can't read the baseline {}: {}", path.string(),
+                            e.what()));
+        }
+
+        return baseline;
     }
 
-    // Reporters for the bench() function templates.
-    namespace report {
-        constexpr auto time_only = [](const auto dt) {
-            fmt::print(" ({} ms)\n", dt / 1ms);
-        };
+    // Finds the smallest two-sided p-value the Mann-Whitney U test can give
+    // for samples of two sizes: that of the two most extreme orderings, out
+    // of all (n1 + n2 choose n1) of them.
+    [[nodiscard]]
+    double min_mann_whitney_p(const std::size_t n1, const std::size_t n2)
+    {
+        if (n1 == 0u || n2 == 0u) return 1.0;
 
-        constexpr auto compact = [](const auto dt) {
-            fmt::print("Done.");
-            time_only(dt);
-        };
+        auto orderings = 1.0;
+        for (std::size_t i = 1u; i <= n1; ++i) {
+            orderings *= static_cast<double>(n2 + i);
+            orderings /= static_cast<double>(i);
+        }
 
-        constexpr auto full = [](const auto dt) {
-            fmt::print("\nTest completed in about {:.1f} seconds ({} ms).\n",
-                       dt / 1.0s, dt / 1ms);
-        };
+        return std::min(1.0, 2.0 / orderings);
     }
 
-    // Calls a medadic functor and returns its result or, if void, a monostate.
-    template<typename Action>
-    decltype(auto) call(Action&& action)
+    // Tests if two sets of samples are from the same distribution, by the
+    // Mann-Whitney U test, and returns the two-sided p-value. This needs no
+    // assumption of normality, which times (skewed by interruptions) don't
+    // meet. Without ties, and for up to 20 samples each, U's distribution is
+    // counted exactly. Otherwise it is approximated as normal, correcting
+    // for ties.
+    [[nodiscard]]
+    double mann_whitney_p(const std::vector<double>& x,
+                          const std::vector<double>& y)
     {
-        using Ret = decltype(std::forward<Action>(action)());
+        static constexpr std::size_t max_exact {20u};
 
-        static_assert(!std::is_same_v<std::decay_t<Ret>, std::monostate>,
-                      "monostate as a real result would be ambiguous");
+        const auto n1 = x.size(), n2 = y.size();
+        if (n1 == 0u || n2 == 0u) return 1.0;
 
-        if constexpr (std::is_same_v<Ret, void>) {
-            std::forward<Action>(action)();
-            return std::monostate{};
+        std::vector<std::pair<double, bool>> all; // each value, and if in x
+        for (const auto value : x) all.emplace_back(value, true);
+        for (const auto value : y) all.emplace_back(value, false);
+        std::sort(begin(all), end(all));
+
+        // Sum x's ranks, giving tied values the mean of their ranks.
+        auto rank_sum = 0.0, ties = 0.0;
+        for (std::size_t i = 0u; i != all.size(); ) {
+            auto j = i;
+            while (j != all.size() && all[j].first == all[i].first) ++j;
+
+            const auto rank = static_cast<double>(i + 1u + j) / 2.0;
+            for (auto k = i; k != j; ++k)
+                if (all[k].second) rank_sum += rank;
+
+            const auto t = static_cast<double>(j - i);
+            ties += t * t * t - t;
+            i = j;
         }
-        else return std::forward<Action>(action)();
+
+        const auto m = static_cast<double>(n1), n = static_cast<double>(n2);
+        const auto u = rank_sum - m * (m + 1.0) / 2.0;
+
+        if (ties == 0.0 && n1 <= max_exact && n2 <= max_exact) {
+            // Count the orderings giving each U: the coefficients of the
+            // Gaussian binomial coefficient, prod (1 - q^(n2+i)) / (1 - q^i).
+            const auto top = n1 * n2;
+            std::vector<double> counts (top + 1u);
+            counts[0] = 1.0;
+
+            for (std::size_t i = 1u; i <= n1; ++i) {
+                for (auto k = top; k >= n2 + i; --k)
+                    counts[k] -= counts[k - (n2 + i)];
+                for (auto k = i; k <= top; ++k) counts[k] += counts[k - i];
+            }
+
+            const auto observed = gsl::narrow_cast<std::size_t>(
+                                    std::llround(u));
+            const auto total = std::accumulate(cbegin(counts), cend(counts),
+                                               0.0);
+            const auto below = std::accumulate(
+                    cbegin(counts),
+                    cbegin(counts) + gsl::narrow_cast<std::ptrdiff_t>(
+                                        observed + 1u),
+                    0.0);
+            const auto above = total - below + counts[observed];
+
+            return std::min(1.0, 2.0 * std::min(below, above) / total);
+        }
+
+        const auto count = m + n;
+        const auto variance = m * n / 12.0
+                                * (count + 1.0
+                                    - ties / (count * (count - 1.0)));
+        if (variance <= 0.0) return 1.0;
+
+        const auto z = std::max(std::abs(u - m * n / 2.0) - 0.5, 0.0)
+                        / std::sqrt(variance);
+        return std::erfc(z / std::sqrt(2.0));
     }
 
-    // Times an action and passes its duration to a reporter. (Results shouldn't
-    // be reported if the task throws an exception, so I did it this way and not
-    // with an RAII class whose destructor reports. But I could've made and used
-    // such a class, if it only reported when std::uncaught_exceptions() == 0.)
-    template<typename Reporter, typename Action>
-    decltype(auto) bench(Reporter&& reporter, Action&& action)
+    // Prints how the host, or a run's parameters, differ from a baseline's.
+    // The seed is skipped, since it's usually new each time.
+    void print_field_changes(const std::string_view what,
+                             const SavedFields& saved,
+                             const std::vector<Field>& fields)
     {
-        using clock = std::chrono::steady_clock;
+        for (const auto& field : fields) {
+            if (field.name == "seed") continue;
 
-        const auto ti = clock::now();
-#ifdef _MSC_VER
-#pragma warning(suppress: 26496) // https://stackoverflow.com/a/48263092
+            const auto p = std::find_if(cbegin(saved), cend(saved),
+                                        [&field](const auto& entry) {
+                return entry.first == field.name;
+            });
+            const auto value = field.value.value_or("null");
+
+            if (p != cend(saved) && p->second != value) {
+                fmt::print(console, "  {} {} was {}, is now {}.\n", what,
+                           field.name, p->second, value);
+            }
+        }
+    }
+
+    // Compares each stage of each run with the baseline's, printing the
+    // difference of the medians and how significant it is. A stage regresses
+    // if it got slower by more than the threshold and the difference is
+    // significant. Returns how many stages regressed.
+    [[nodiscard]]
+    int compare_with_baseline(const Parameters& params,
+                              const Baseline& baseline,
+                              const std::vector<Run>& runs)
+    {
+        static constexpr auto alpha = 0.05;
+
+        fmt::print(console, "\nComparing with the baseline {}:\n",
+                   params.compare->string());
+        print_field_changes("Host:", baseline.host,
+                            host_fields(describe_host()));
+
+        if (baseline.runs.size() != runs.size()) {
+            fmt::print(console,
+                       "  The baseline has {} run{}, but this has {}.\n",
+                       baseline.runs.size(),
+                       (baseline.runs.size() == 1u ? "" : "s"), runs.size());
+        }
+
+        auto regressions = 0;
+        const auto count = std::min(baseline.runs.size(), runs.size());
+
+        for (std::size_t i = 0u; i != count; ++i) {
+            const auto& saved = baseline.runs[i];
+            if (count > 1u) fmt::print(console, "Run {}:\n", i + 1u);
+            print_field_changes("Parameter", saved.parameters,
+                                parameter_fields(runs[i].params));
+
+            fmt::print(console, "{:<20}{:>12}{:>12}{:>10}{:>10}\n",
+                       "", "was (ms)", "now (ms)", "change", "p");
+
+            for (const auto& stage : collate(runs[i].trials)) {
+                const auto p = std::find_if(cbegin(saved.stages),
+                                            cend(saved.stages),
+                                            [&stage](const SavedStage& s) {
+                    return s.name == stage.name;
+                });
+                if (p == cend(saved.stages) || p->samples_ms.empty()) {
+                    fmt::print(console, "{:<20}  (not in the baseline)\n",
+                               stage.name);
+                    continue;
+                }
+
+                std::vector<double> samples;
+                for (const auto dt : stage.samples) {
+                    samples.push_back(
+                            std::chrono::duration<double, std::milli>{dt}
+                                .count());
+                }
+
+                const auto was = median_of(p->samples_ms);
+                const auto now = median_of(samples);
+                const auto change = (was > 0.0 ? now / was - 1.0 : 0.0);
+                const auto pvalue = mann_whitney_p(p->samples_ms, samples);
+
+                const auto significant = (pvalue < alpha);
+                const auto regressed = significant
+                                        && change > params.threshold;
+                if (regressed) ++regressions;
+
+                // An old baseline may have too few trials for any change to
+                // be significant, which would otherwise look like no change.
+                const auto decidable = (min_mann_whitney_p(
+                                            p->samples_ms.size(),
+                                            samples.size()) < alpha);
+
+                fmt::print(console,
+                           "{:<20}{:>12.3f}{:>12.3f}{:>+9.1f}%{:>10.3f}{}\n",
+                           stage.name, was, now, change * 100.0, pvalue,
+                           (regressed ? "  REGRESSED"
+                            : significant && change < -params.threshold
+                                ? "  faster"
+                            : !decidable ? "  (too few trials)" : ""));
+            }
+        }
+
+        if (regressions == 0) {
+            fmt::print(console,
+                       "No stage regressed past {}% (at p < {}).\n",
+                       params.threshold * 100.0, alpha);
+        }
+        else {
+            fmt::print(console,
+                       "{} stage{} regressed past {}% (at p < {}).\n",
+                       regressions, (regressions == 1 ? "" : "s"),
+                       params.threshold * 100.0, alpha);
+        }
+
+        return regressions;
+    }
+
+    // Samples the process on a thread of its own while it runs, writing a
+    // CSV record at each interval (see --sample): the stages running, the
+    // resident set size, how many CPUs' worth of time the process used, how
+    // busy the least and most busy CPUs were (system-wide), and, with
+    // --counters, traffic estimated from LLC misses. A stage running alone
+    // for long also gets its progress shown after its label.
+    class Sampler {
+    public:
+        Sampler(File file, std::filesystem::path path,
+                const std::chrono::milliseconds interval)
+            : file_{std::move(file)}, path_{std::move(path)},
+              interval_{interval}, console_{console},
+              start_{live::clock::now()}
+        {
+            fmt::print(file_.get(),
+                       "time_s,stages,rss_bytes,cpus_used,"
+                       "least_busy_cpu_percent,most_busy_cpu_percent,"
+                       "llc_miss_gib_per_s\n");
+
+            live::tracking = true;
+            thread_ = std::thread{[this] { run(); }};
+
+            // Exiting with the thread running would destroy what it reads.
+            running_ = this;
+            before_exit = [] { running_->join(); };
+        }
+
+        Sampler(const Sampler&) = delete;
+        Sampler& operator=(const Sampler&) = delete;
+
+        ~Sampler() { join(); }
+
+        // Stops sampling, and closes the file.
+        void finish()
+        {
+            join();
+            if (std::fclose(file_.release()) != 0)
+                die(fmt::format("can't write {}", path_.string()));
+            fmt::print(console, "Wrote {} samples to {}.\n", samples_,
+                       path_.string());
+        }
+
+    private:
+        // Long stages show progress this often.
+        static constexpr std::chrono::seconds progress_period {5};
+
+        // Bytes per LLC miss, assumed.
+        static constexpr std::uint64_t line_bytes {64u};
+
+        // Ticks a CPU spent busy (not idle or waiting for I/O), and in all.
+        struct CpuTicks {
+            std::uint64_t busy;
+            std::uint64_t total;
+        };
+
+        struct Reading {
+            live::clock::time_point time;
+            std::optional<std::chrono::microseconds> cpu; // user and system
+            std::vector<CpuTicks> cpus;
+            std::optional<std::uint64_t> llc_misses;
+        };
+
+        [[nodiscard]]
+        static Reading read()
+        {
+            Reading reading {live::clock::now(), std::nullopt, {},
+                             std::nullopt};
+
+#ifdef PMB_HAVE_RUSAGE
+            if (rusage usage {}; getrusage(RUSAGE_SELF, &usage) == 0) {
+                const auto time = [](const timeval& tv) {
+                    return std::chrono::seconds{tv.tv_sec}
+                            + std::chrono::microseconds{tv.tv_usec};
+                };
+                reading.cpu = time(usage.ru_utime) + time(usage.ru_stime);
+            }
 #endif
-        decltype(auto) ret = call(std::forward<Action>(action));
-        const auto tf = clock::now();
 
-        std::forward<Reporter>(reporter)(tf - ti);
-        return ret;
+#ifdef PMB_HAVE_PROCFS
+            // After the total's "cpu" line, a "cpuN" line gives each CPU's
+            // user, nice, system, idle, iowait, irq, softirq, and steal ticks.
+            std::ifstream stat {"/proc/stat"};
+            for (std::string line; std::getline(stat, line); ) {
+                if (line.compare(0u, 3u, "cpu") != 0 || line.size() < 4u
+                        || !std::isdigit(static_cast<unsigned char>(line[3])))
+                    continue;
+
+                std::istringstream fields {line.substr(line.find(' '))};
+                CpuTicks ticks {};
+                std::uint64_t value {};
+
+                for (auto i = 0; i != 8 && fields >> value; ++i) {
+                    ticks.total += value;
+                    if (i != 3 && i != 4) ticks.busy += value;
+                }
+                reading.cpus.push_back(ticks);
+            }
+#endif
+
+#ifdef PMB_HAVE_PERF
+            if (const auto& perf = perf_counters())
+                reading.llc_misses = perf->read().llc_misses;
+#endif
+
+            return reading;
+        }
+
+        // Samples at fixed times, unless sampling falls behind, until stopped.
+        void run()
+        {
+            heap::uncounted = true;
+
+            auto last = read();
+            auto next = last.time + interval_;
+            std::unique_lock lock {mutex_};
+
+            while (!wake_.wait_until(lock, next, [this] { return stop_; })) {
+                lock.unlock();
+                auto now = read();
+                sample(last, now);
+                last = std::move(now);
+                next = std::max(next + interval_, live::clock::now());
+                lock.lock();
+            }
+        }
+
+        // Writes a record of what changed between two readings, and shows
+        // progress if it's due.
+        void sample(const Reading& last, const Reading& now)
+        {
+            const auto seconds = std::chrono::duration<double>{
+                    now.time - last.time}.count();
+            const auto rss = status_bytes("VmRSS:");
+
+            std::optional<double> cpus_used;
+            if (now.cpu && last.cpu) {
+                cpus_used = std::chrono::duration<double>{
+                        *now.cpu - *last.cpu}.count() / seconds;
+            }
+
+            std::optional<double> least, most;
+            if (now.cpus.size() == last.cpus.size()) {
+                for (std::size_t i = 0u; i != now.cpus.size(); ++i) {
+                    const auto total = now.cpus[i].total - last.cpus[i].total;
+                    if (total == 0u) continue;
+
+                    const auto busy = static_cast<double>(
+                            now.cpus[i].busy - last.cpus[i].busy)
+                                / static_cast<double>(total) * 100.0;
+                    least = std::min(least.value_or(busy), busy);
+                    most = std::max(most.value_or(busy), busy);
+                }
+            }
+
+            std::optional<double> llc_gib_per_s;
+            if (now.llc_misses && last.llc_misses) {
+                llc_gib_per_s = static_cast<double>(
+                        (*now.llc_misses - *last.llc_misses) * line_bytes)
+                            / static_cast<double>(std::uint64_t{1} << 30)
+                            / seconds;
+            }
+
+            const auto field = [](const auto& value, const char* format) {
+                return (value ? fmt::format(format, *value) : std::string{});
+            };
+
+            std::string stages;
+            {
+                const std::lock_guard lock {live::mutex};
+
+                for (const auto& stage : live::stages) {
+                    stages += fmt::format("{}{}", (stages.empty() ? "" : " + "),
+                                          stage.label);
+                }
+
+                // Only a stage running alone, on the main output, shows
+                // progress, so it can't print into some other line.
+                if (live::stages.size() == 1u) {
+                    auto& stage = live::stages.front();
+                    const auto elapsed = now.time - stage.start;
+                    const auto due = elapsed / progress_period;
+
+                    if (stage.console == console_ && due > stage.reports) {
+                        stage.reports = gsl::narrow_cast<int>(due);
+                        fmt::print(console_, "[{} s: {} CPUs, RSS {}] ",
+                                   std::chrono::duration_cast<
+                                       std::chrono::seconds>(elapsed).count(),
+                                   field(cpus_used, "{:.1f}"),
+                                   (rss ? format_bytes(*rss) : "unknown"));
+                        std::fflush(console_);
+                    }
+                }
+            }
+
+            fmt::print(file_.get(), "{:.3f},{},{},{},{},{},{}\n",
+                       std::chrono::duration<double>{now.time - start_}
+                            .count(),
+                       csv_quote(stages), field(rss, "{}"),
+                       field(cpus_used, "{:.2f}"), field(least, "{:.1f}"),
+                       field(most, "{:.1f}"), field(llc_gib_per_s, "{:.2f}"));
+            std::fflush(file_.get());
+            ++samples_;
+        }
+
+        void join()
+        {
+            if (!thread_.joinable()) return;
+
+            {
+                const std::lock_guard lock {mutex_};
+                stop_ = true;
+            }
+            wake_.notify_one();
+            thread_.join();
+            live::tracking = false;
+
+            running_ = nullptr;
+            before_exit = nullptr;
+        }
+
+        // The sampler whose thread is running, if any.
+        static inline Sampler* running_ {nullptr};
+
+        File file_;
+        std::filesystem::path path_;
+        std::chrono::milliseconds interval_;
+        std::FILE* console_; // the main thread's, where progress is shown
+        live::clock::time_point start_;
+        std::uint64_t samples_ {0u};
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        bool stop_ {false}; // guarded by mutex_
+        std::thread thread_;
+    };
+
+    // Parses arguments as pmb's options, where the first names the program.
+    [[nodiscard]]
+    po::variables_map parse_args(const std::vector<std::string>& args)
+    {
+        std::vector<const char*> argv;
+        for (const auto& arg : args) argv.push_back(arg.c_str());
+        argv.push_back(nullptr);
+
+        return parse_cmdline_args(gsl::narrow_cast<int>(args.size()),
+                                  gsl::not_null{argv.data()});
     }
 
-    // Prints an action's name, times it, and passes its duration to a reporter.
-    template<typename Reporter, typename Action>
-    decltype(auto) bench(const std::string_view label,
-                         Reporter&& reporter, Action&& action)
+    // Parses pmb's options for benchmarks, so they get its defaults and
+    // checks. Each benchmark sets its own type, policy, and length, so a
+    // length is filled in if there's none. Without --algorithm, samplesort is
+    // chosen, so its buckets are sized, and every algorithm is benchmarked.
+    [[nodiscard]]
+    std::pair<Parameters, std::optional<SortAlgorithm>>
+    parse_bench_parameters(std::vector<std::string> args)
     {
-        fmt::print("{}... ", label);
-        std::fflush(stdout);
-        return bench(std::forward<Reporter>(reporter),
-                     std::forward<Action>(action));
+        assert(!args.empty());
+        program_name = std::filesystem::path{args.front()}.filename().string();
+
+        const auto vm = parse_args(args);
+        const auto chosen = (vm.count("algorithm") != 0u);
+        if (!vm.count("length")) args.insert(end(args), {"--length", "1"});
+        if (!chosen) args.insert(end(args), {"--algorithm", "sample"});
+
+        const auto params = extract_operating_parameters(parse_args(args));
+        return {params, (chosen ? std::optional{params.algorithm}
+                                : std::nullopt)};
     }
 
-    // TODO: Extract the number-generating stanza (and accompanying static
-    //       assertion) into its own function, and also implement a trivial
-    //       alternative with std::iota to get more insight into adaptivity.
-    void test(const Parameters& params, std::mt19937& gen)
+    // Parameters for one kernel's benchmarks.
+    template<typename T, typename Algorithm = StdSort,
+             typename Policy = sequenced_policy>
+    [[nodiscard]]
+    Parameters kernel_parameters(Parameters params)
     {
-        static_assert(same_range_v<std::mt19937, std::numeric_limits<unsigned>>,
-                      "the PRNG and the output type have different ranges");
+        params.element_type = ElementTag<T>{};
+        params.algorithm = Algorithm{};
+        params.mode = Policy{};
+        return params;
+    }
 
-        std::vector<unsigned> a;
+    // Makes an array of a length, generated as pmb would.
+    template<typename T>
+    [[nodiscard]]
+    Array<T> make_input(Parameters& params, const std::size_t length)
+    {
+        params.length = length;
 
-        bench("Allocating/zeroing", report::compact, [&] {
-            a.resize(params.length);
-        });
+        Array<T> a (params.length, T{}, Allocator<T>{params});
+        typename ElementTraits<T>::Engine gen {params.seed};
+        generate_range(params.distribution, a, 0u, a.size(), gen);
+        return a;
+    }
 
-        bench("Generating", report::compact, [&] {
-            std::generate(begin(a), end(a), std::ref(gen));
-        });
+    // What a benchmarked stage's array holds when each run starts: what the
+    // last run left, the generated input again, or the input sorted once.
+    enum class BenchInput { kept, fresh, sorted };
 
-        const auto s1 = bench("Hashing", report::time_only, [&] {
-            auto s = std::accumulate(cbegin(a), cend(a), 0u);
-            fmt::print("{:x}.", s);
-            return s;
-        });
+    // Makes a benchmark of a stage, which runs an action on an array of the
+    // benchmark's length.
+    template<typename T, typename Action>
+    [[nodiscard]]
+    pmb::BenchStage bench_stage(std::string name, const unsigned passes,
+                                const Parameters& params, const Action& action,
+                                const BenchInput input = BenchInput::kept)
+    {
+        auto setup = [params, action, input](const std::size_t length) {
+            auto own = params;
+            const auto a = std::make_shared<Array<T>>(make_input<T>(own,
+                                                                    length));
+            if (input == BenchInput::sorted) std::sort(begin(*a), end(*a));
 
-        for (auto i = params.inplace_reps; i > 0; --i) {
-            bench("Sorting", report::compact, [&] {
-                visit([&](auto policy) { std::sort(policy, begin(a), end(a)); },
-                      params.mode);
-            });
-        }
+            pmb::StageRun stage {{}, [own, a, action] { action(own, *a); }};
 
-        bench("Rehashing", report::time_only, [&] {
-            const auto s2 = std::accumulate(cbegin(a), cend(a), 0u);
-            fmt::print("{:x}, {}", s2, (s1 == s2 ? "same." : "DIFFERENT!"));
-        });
+            if (input == BenchInput::fresh) {
+                stage.reset = [a, copy = std::make_shared<const Array<T>>(*a)] {
+                    std::copy(cbegin(*copy), cend(*copy), begin(*a));
+                };
+            }
+
+            return stage;
+        };
+
+        return {std::move(name), std::uint64_t{sizeof(T)} * passes,
+                std::move(setup)};
+    }
+
+    // Makes the benchmarks of the stages that don't depend on the policy.
+    template<typename T>
+    void add_serial_stages(std::vector<pmb::BenchStage>& stages,
+                           const Parameters& base)
+    {
+        const auto name = ElementTraits<T>::name;
+        const auto params = kernel_parameters<T>(base);
+
+        stages.push_back(bench_stage<T>(
+                fmt::format("allocate/{}", name), 1u, params,
+                [](const Parameters& own, const Array<T>& a) {
+                    Array<T> b {Allocator<T>{own}};
+                    b.resize(a.size());
+                    keep(b.data());
+                }));
+
+        stages.push_back(bench_stage<T>(
+                fmt::format("generate/{}", name), 1u, params,
+                [](const Parameters& own, Array<T>& a) {
+                    typename ElementTraits<T>::Engine gen {own.seed};
+                    generate_range(own.distribution, a, 0u, a.size(), gen);
+                }));
+    }
+
+    // Makes the benchmarks of the stages that run in a policy: generating in
+    // blocks, hashing, each sorting kernel this build has (or just those for
+    // one algorithm), and checking.
+    template<typename T, typename Policy>
+    void add_policy_stages(std::vector<pmb::BenchStage>& stages,
+                           const Parameters& base,
+                           const std::optional<SortAlgorithm>& only)
+    {
+        const auto name = ElementTraits<T>::name;
+        const auto policy_option = policy_name<Policy>;
+        const auto params = kernel_parameters<T, StdSort, Policy>(base);
+
+        stages.push_back(bench_stage<T>(
+                fmt::format("generate-blocks/{}/{}", name, policy_option), 1u,
+                params, [](const Parameters& own, Array<T>& a) {
+                    generate_blockwise(own.mode, own.distribution, a,
+                                       own.seed);
+                }));
+
+        stages.push_back(bench_stage<T>(
+                fmt::format("hash/{}/{}", name, policy_option), 1u, params,
+                [](const Parameters& own, const Array<T>& a) {
+                    keep(checksum(own.mode, a));
+                }));
+
+        for_each_alternative<SortAlgorithm>([&](auto algorithm) {
+            using Algorithm = decltype(algorithm);
 
-        bench("Checking", report::time_only, [&] {
-            const auto ok = std::is_sorted(cbegin(a), cend(a));
-            fmt::print("{}", (ok ? "sorted." : "NOT SORTED!"));
+            if constexpr (has_sort_kernel<Algorithm, Policy, T>) {
+                if (only && !std::holds_alternative<Algorithm>(*only)) return;
+
+                // Each run sorts a fresh copy of the input.
+                stages.push_back(bench_stage<T>(
+                        fmt::format("sort/{}/{}/{}", name, Algorithm::name,
+                                    policy_option),
+                        2u, kernel_parameters<T, Algorithm, Policy>(base),
+                        [](const Parameters& own, Array<T>& a) {
+                            static_cast<void>(sort_kernel<Algorithm>(
+                                    own, Policy{}, a));
+                        },
+                        BenchInput::fresh));
+            }
         });
+
+        stages.push_back(bench_stage<T>(
+                fmt::format("check/{}/{}", name, policy_option), 1u, params,
+                [](const Parameters& own, const Array<T>& a) {
+                    keep(check_order(own, a).ok);
+                }, BenchInput::sorted));
+    }
+}
+
+// The benchmarks' parameters, and the threads' setup while benchmarks run.
+struct pmb::BenchSuite::State {
+    State(const Parameters& params,
+          const std::optional<SortAlgorithm>& algorithm)
+        : base {params}, only {algorithm},
+          setup {kernel_parameters<std::uint32_t, StdSort, pool_policy>(params),
+                 false}
+    {
     }
+
+    Parameters base;
+    std::optional<SortAlgorithm> only; // if --algorithm was given
+    ThreadSetup setup;
+};
+
+pmb::BenchSuite::BenchSuite(const std::vector<std::string>& args)
+{
+    const auto [base, only] = parse_bench_parameters(args);
+    state_ = std::make_unique<State>(base, only);
+}
+
+pmb::BenchSuite::~BenchSuite() = default;
+
+std::vector<pmb::BenchStage> pmb::BenchSuite::stages() const
+{
+    std::vector<BenchStage> stages;
+
+    for_each_alternative<ElementType>([&](auto tag) {
+        using T = typename decltype(tag)::type;
+
+        if constexpr (has_sort_kernels<T>) {
+            add_serial_stages<T>(stages, state_->base);
+
+            for_each_alternative<ParallelMode>([&](auto policy) {
+                add_policy_stages<T, decltype(policy)>(stages, state_->base,
+                                                       state_->only);
+            });
+        }
+    });
+
+    return stages;
 }
 
-int main(int argc, char** argv)
+int pmb::main(int argc, char** argv)
 {
     const auto params = configure(argc, gsl::not_null{argv});
-    fmt::print("{}\n", params); // the extra newline is intended
-    std::mt19937 gen {params.seed};
+    // Read the baseline first, so a bad one is found before the run.
+    const auto baseline = (params.compare
+                            ? std::optional{load_baseline(*params.compare)}
+                            : std::nullopt);
+    auto baseline_file = (params.save_baseline
+                            ? open_for_writing(*params.save_baseline)
+                            : File{nullptr, &std::fclose});
+    auto sample_file = (params.sample ? open_for_writing(*params.sample)
+                                      : File{nullptr, &std::fclose});
+    if (params.counters) open_counters();
+    // The extra newline is intended.
+    fmt::print(console, "{}{}\n", params, topology::detect());
+
+    // The sampler starts after the counters are open, so it can read them.
+    std::optional<Sampler> sampler;
+    if (params.sample) {
+        sampler.emplace(std::move(sample_file), *params.sample,
+                        params.sample_interval);
+    }
+
+    std::vector<Run> runs;
 
     try {
         bench(report::full, [&] {
-            test(params, gen);
+            runs = run_sweep(params);
+            write_results(params.format, runs);
         });
     }
     catch (const std::bad_alloc&) {
-        fmt::print("\n"); // end the "Allocating/zeroing..." line
+        fmt::print(console, "\n"); // end the "Allocating/zeroing..." line
         die("not enough memory");
     }
+    catch (const external::IoError& e) {
+        fmt::print(console, "\n"); // end the stage's line
+        die(e.what());
+    }
+
+    if (sampler) sampler->finish();
+
+    if (baseline_file) {
+        save_baseline(std::move(baseline_file), *params.save_baseline, runs);
+    }
+
+    if (baseline && compare_with_baseline(params, *baseline, runs) != 0)
+        return regressed_exit_status;
+
+    return EXIT_SUCCESS;
 }
@@ -0,0 +1,72 @@
+// Copyright (c) 2018, 2019, 2023 Eliah Kagan and David Vassallo
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+// OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+// What pmb.cpp offers the programs built from it: pmb itself (pmb_main.cpp),
+// and microbenchmarks of its stages (pmb_bench.cpp). Everything else in
+// pmb.cpp is internal to it.
+
+#ifndef PMB_H
+#define PMB_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace pmb {
+    // Runs pmb with command-line arguments, returning its exit status.
+    int main(int argc, char** argv);
+
+    // A stage set up, on its own array, to be run repeatedly. Calling reset
+    // (if it's set) undoes what a run did, so the next run redoes it.
+    struct StageRun {
+        std::function<void()> reset;
+        std::function<void()> run;
+    };
+
+    // A stage to benchmark: its name, with parts joined by slashes (like
+    // "sort/u32/radix/par"), the bytes a run accesses per element, counting
+    // each pass, and how to set it up at a length.
+    struct BenchStage {
+        std::string name;
+        std::uint64_t bytes_per_element;
+        std::function<StageRun(std::size_t)> setup;
+    };
+
+    // pmb's stages, for every element type and policy the build sorts, with
+    // pmb's options (but not the type, policy, or length) applied to all of
+    // them. While this exists, threads are set up as those options say, and
+    // the pool runs, for the stages that use it.
+    class BenchSuite {
+    public:
+        // Parses pmb's options. The first argument is the program's name.
+        explicit BenchSuite(const std::vector<std::string>& args);
+
+        BenchSuite(const BenchSuite&) = delete;
+        BenchSuite& operator=(const BenchSuite&) = delete;
+
+        ~BenchSuite();
+
+        [[nodiscard]]
+        std::vector<BenchStage> stages() const;
+
+    private:
+        struct State;
+
+        std::unique_ptr<State> state_;
+    };
+}
+
+#endif // PMB_H
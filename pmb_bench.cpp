@@ -0,0 +1,95 @@
+// Copyright (c) 2018, 2019, 2023 Eliah Kagan and David Vassallo
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+// OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+// Microbenchmarks of pmb's stages, on Google Benchmark, so they can be run and
+// compared with its usual tools. Each stage (allocating, generating, hashing,
+// sorting with each kernel this build has, and checking) is registered for each
+// element type and policy, at lengths from 1 Ki to 16 Mi elements. Run with
+// --benchmark_repetitions for statistics across repetitions (min and max, as
+// well as the usual mean, median, and standard deviation), and filter with
+// --benchmark_filter, as usual. Arguments that Google Benchmark doesn't take
+// are pmb's own options, applying to every benchmark, like --alloc mmap or
+// --distribution zipf (but not --type, a policy, or --length). --algorithm
+// limits the sorting benchmarks to that algorithm.
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include <gsl/gsl>
+#include "pmb.h"
+
+namespace {
+    // The lengths benchmarks run at: each is this many times the last.
+    constexpr std::int64_t min_bench_length {std::int64_t{1} << 10};
+    constexpr std::int64_t max_bench_length {std::int64_t{1} << 24};
+    constexpr int bench_length_multiplier {8};
+
+    // Sets a benchmark's lengths, and its statistics across repetitions.
+    void configure_benchmark(benchmark::internal::Benchmark& bm)
+    {
+        bm.RangeMultiplier(bench_length_multiplier)
+          ->Range(min_bench_length, max_bench_length)
+          ->ComputeStatistics("min", [](const std::vector<double>& v) {
+              return *std::min_element(cbegin(v), cend(v));
+          })
+          ->ComputeStatistics("max", [](const std::vector<double>& v) {
+              return *std::max_element(cbegin(v), cend(v));
+          })
+          ->UseRealTime();
+    }
+
+    // Registers a stage as a benchmark. Each iteration runs the stage once,
+    // after resetting it (if it's reset) while the timer is paused.
+    void add(const pmb::BenchStage& stage)
+    {
+        const auto function = [stage](benchmark::State& state) {
+            const auto length = state.range(0);
+            auto run = stage.setup(gsl::narrow_cast<std::size_t>(length));
+
+            for (auto _ : state) {
+                if (run.reset) {
+                    state.PauseTiming();
+                    run.reset();
+                    state.ResumeTiming();
+                }
+
+                run.run();
+                benchmark::ClobberMemory();
+            }
+
+            // Throughput per element and per byte, for passes over the array.
+            const auto elements = state.iterations() * length;
+            state.SetItemsProcessed(elements);
+            state.SetBytesProcessed(
+                    elements
+                    * gsl::narrow_cast<std::int64_t>(stage.bytes_per_element));
+        };
+
+        configure_benchmark(*benchmark::RegisterBenchmark(stage.name.c_str(),
+                                                          function));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    benchmark::Initialize(&argc, argv);
+
+    // What Google Benchmark didn't take is for pmb (see above).
+    const pmb::BenchSuite suite {{argv, argv + argc}};
+
+    for (const auto& stage : suite.stages()) add(stage);
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+}